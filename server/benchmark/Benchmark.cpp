@@ -0,0 +1,626 @@
+#include "../include/Stats.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Load generator for a running server, in the spirit of redis-benchmark:
+// every thread drives its share of the connections from one epoll loop, each
+// connection keeping a batch of `pipeline` commands in flight, and every
+// reply's latency is measured from the moment its batch was sent.
+
+enum class OutputFormat { Text, Csv, Json };
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 6379;
+    unsigned int clients = 20; // Fits under the server's per event loop client limit
+    uint64_t requests = 100000;
+    unsigned int pipeline = 1;
+    uint64_t keyspace = 0; // Random key suffixes below this, 0 = always the same key
+    unsigned int dataSize = 3;
+    unsigned int threads = 1;
+    std::vector<std::string> tests;
+    OutputFormat format = OutputFormat::Text;
+};
+
+// Appends one command to out; rand is the key (or field) number for this request
+using CommandBuilder = void (*)(std::string& out, uint64_t rand, const std::string& value);
+
+struct Workload {
+    const char* name;
+    CommandBuilder build;
+};
+
+static void appendCommand(std::string& out, std::initializer_list<std::string_view> args) {
+    out += '*';
+    out += std::to_string(args.size());
+    out += "\r\n";
+    for (std::string_view arg : args) {
+        out += '$';
+        out += std::to_string(arg.size());
+        out += "\r\n";
+        out.append(arg);
+        out += "\r\n";
+    }
+}
+
+// Fixed width like redis-benchmark's __rand_int__, so every key has the same length
+static std::string keyName(const char* prefix, uint64_t rand) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%s%012llu", prefix, static_cast<unsigned long long>(rand));
+    return buffer;
+}
+
+static const Workload WORKLOADS[] = {
+    {"SET", [](std::string& out, uint64_t rand, const std::string& value) {
+        appendCommand(out, {"SET", keyName("key:", rand), value});
+    }},
+    {"GET", [](std::string& out, uint64_t rand, const std::string&) {
+        appendCommand(out, {"GET", keyName("key:", rand)});
+    }},
+    {"LPUSH", [](std::string& out, uint64_t rand, const std::string& value) {
+        appendCommand(out, {"LPUSH", keyName("list:", rand), value});
+    }},
+    {"LPOP", [](std::string& out, uint64_t rand, const std::string&) {
+        appendCommand(out, {"LPOP", keyName("list:", rand)});
+    }},
+    {"HSET", [](std::string& out, uint64_t rand, const std::string& value) {
+        appendCommand(out, {"HSET", "myhash", keyName("field:", rand), value});
+    }},
+    {"HGET", [](std::string& out, uint64_t rand, const std::string&) {
+        appendCommand(out, {"HGET", "myhash", keyName("field:", rand)});
+    }},
+};
+
+static const Workload* findWorkload(std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::toupper(c); });
+    for (const Workload& workload : WORKLOADS) {
+        if (name == workload.name) {
+            return &workload;
+        }
+    }
+    return nullptr;
+}
+
+// End of the reply starting at pos, or npos if it has not fully arrived.
+// Only the framing is checked, replies are not decoded.
+static size_t skipReply(std::string_view buffer, size_t pos, bool& malformed) {
+    if (pos >= buffer.size()) {
+        return std::string_view::npos;
+    }
+    size_t lineEnd = buffer.find("\r\n", pos);
+    if (lineEnd == std::string_view::npos) {
+        return std::string_view::npos;
+    }
+    char type = buffer[pos];
+    if (type == '+' || type == '-' || type == ':') {
+        return lineEnd + 2;
+    }
+    long long length;
+    try {
+        length = std::stoll(std::string(buffer.substr(pos + 1, lineEnd - pos - 1)));
+    } catch (const std::exception&) {
+        malformed = true;
+        return std::string_view::npos;
+    }
+    size_t next = lineEnd + 2;
+    if (type == '$') {
+        if (length < 0) {
+            return next;
+        }
+        size_t end = next + static_cast<size_t>(length) + 2;
+        return end <= buffer.size() ? end : std::string_view::npos;
+    }
+    if (type == '*') {
+        for (long long i = 0; i < length; i++) {
+            next = skipReply(buffer, next, malformed);
+            if (next == std::string_view::npos) {
+                return next;
+            }
+        }
+        return next;
+    }
+    malformed = true;
+    return std::string_view::npos;
+}
+
+// Takes up to want requests from the shared budget, 0 once it is used up
+static uint64_t claimRequests(std::atomic<uint64_t>& remaining, uint64_t want) {
+    uint64_t left = remaining.load(std::memory_order_relaxed);
+    while (left > 0) {
+        uint64_t take = std::min(left, want);
+        if (remaining.compare_exchange_weak(left, left - take, std::memory_order_relaxed)) {
+            return take;
+        }
+    }
+    return 0;
+}
+
+static int connectTo(const Options& options, std::string& error) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1) {
+        error = "invalid IPv4 address " + options.host;
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = std::string("socket: ") + strerror(errno);
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        error = "could not connect to " + options.host + ":" + std::to_string(options.port) + ": " + strerror(errno);
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+struct WorkerResult {
+    uint64_t completed = 0;
+    uint64_t errors = 0; // Error replies
+    uint64_t totalMicros = 0;
+    uint64_t maxMicros = 0;
+    LatencyHistogram latency;
+    std::string failure; // Set if the worker had to give up
+};
+
+// One thread's connections and the epoll loop driving them
+class Worker {
+    public:
+        Worker(const Options& options, const Workload& workload, std::atomic<uint64_t>& remaining, uint64_t seed)
+            : options(options), workload(workload), remaining(remaining), random(seed), value(options.dataSize, 'x') {}
+
+        ~Worker() {
+            for (Connection& connection : connections) {
+                close(connection.fd);
+            }
+            if (epollFd >= 0) {
+                close(epollFd);
+            }
+        }
+
+        bool connect(unsigned int count, std::string& error) {
+            for (unsigned int i = 0; i < count; i++) {
+                int fd = connectTo(options, error);
+                if (fd < 0) {
+                    return false;
+                }
+                Connection connection;
+                connection.fd = fd;
+                connections.push_back(std::move(connection));
+            }
+            return true;
+        }
+
+        void run() {
+            epollFd = epoll_create1(0);
+            if (epollFd < 0) {
+                result.failure = std::string("epoll_create1: ") + strerror(errno);
+                return;
+            }
+            size_t active = 0;
+            for (size_t i = 0; i < connections.size(); i++) {
+                epoll_event event{};
+                event.events = EPOLLIN;
+                event.data.u64 = i;
+                if (epoll_ctl(epollFd, EPOLL_CTL_ADD, connections[i].fd, &event) < 0) {
+                    result.failure = std::string("epoll_ctl: ") + strerror(errno);
+                    return;
+                }
+                if (startBatch(connections[i], i)) {
+                    active++;
+                }
+            }
+
+            std::vector<epoll_event> events(std::max<size_t>(connections.size(), 1));
+            auto lastProgress = std::chrono::steady_clock::now();
+            while (active > 0 && result.failure.empty()) {
+                int n = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), POLL_TIMEOUT_MS);
+                if (n < 0 && errno != EINTR) {
+                    result.failure = std::string("epoll_wait: ") + strerror(errno);
+                    break;
+                }
+                if (n <= 0) {
+                    if (std::chrono::steady_clock::now() - lastProgress > STALL_TIMEOUT) {
+                        result.failure = "no reply from the server for " + std::to_string(STALL_TIMEOUT.count()) + " seconds";
+                    }
+                    continue;
+                }
+                lastProgress = std::chrono::steady_clock::now();
+                for (int i = 0; i < n && result.failure.empty(); i++) {
+                    size_t index = events[i].data.u64;
+                    Connection& connection = connections[index];
+                    if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                        result.failure = "connection closed by the server (client limit reached?)";
+                        break;
+                    }
+                    if ((events[i].events & EPOLLOUT) && !flush(connection, index)) {
+                        break;
+                    }
+                    if ((events[i].events & EPOLLIN) && !readReplies(connection, index, active)) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        const WorkerResult& getResult() const { return result; }
+
+    private:
+        static constexpr int POLL_TIMEOUT_MS = 1000;
+        static constexpr std::chrono::seconds STALL_TIMEOUT{10};
+        static constexpr size_t READ_SIZE = 64 * 1024;
+
+        struct Connection {
+            int fd = -1;
+            std::string out;
+            size_t written = 0;
+            std::string in;
+            uint64_t pending = 0; // Replies still expected for the current batch
+            std::chrono::steady_clock::time_point sent;
+            bool writeArmed = false;
+        };
+
+        const Options& options;
+        const Workload& workload;
+        std::atomic<uint64_t>& remaining;
+        std::mt19937_64 random;
+        std::string value;
+        std::vector<Connection> connections;
+        int epollFd = -1;
+        WorkerResult result;
+
+        uint64_t nextRand() {
+            return options.keyspace == 0 ? 0 : random() % options.keyspace;
+        }
+
+        // Queues and sends the next batch, false when there is nothing left to send
+        bool startBatch(Connection& connection, size_t index) {
+            uint64_t batch = claimRequests(remaining, options.pipeline);
+            if (batch == 0) {
+                return false;
+            }
+            connection.out.clear();
+            connection.written = 0;
+            for (uint64_t i = 0; i < batch; i++) {
+                workload.build(connection.out, nextRand(), value);
+            }
+            connection.pending = batch;
+            connection.sent = std::chrono::steady_clock::now();
+            flush(connection, index);
+            return true;
+        }
+
+        bool setEvents(Connection& connection, size_t index, uint32_t events) {
+            epoll_event event{};
+            event.events = events;
+            event.data.u64 = index;
+            if (epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event) < 0) {
+                result.failure = std::string("epoll_ctl: ") + strerror(errno);
+                return false;
+            }
+            return true;
+        }
+
+        // Writes what the socket takes, waiting for EPOLLOUT if it is full
+        bool flush(Connection& connection, size_t index) {
+            while (connection.written < connection.out.size()) {
+                ssize_t sent = send(connection.fd, connection.out.data() + connection.written,
+                                    connection.out.size() - connection.written, MSG_NOSIGNAL);
+                if (sent < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        if (!connection.writeArmed) {
+                            connection.writeArmed = true;
+                            return setEvents(connection, index, EPOLLIN | EPOLLOUT);
+                        }
+                        return true;
+                    }
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    result.failure = std::string("send: ") + strerror(errno);
+                    return false;
+                }
+                connection.written += static_cast<size_t>(sent);
+            }
+            if (connection.writeArmed) {
+                connection.writeArmed = false;
+                return setEvents(connection, index, EPOLLIN);
+            }
+            return true;
+        }
+
+        bool readReplies(Connection& connection, size_t index, size_t& active) {
+            char buffer[READ_SIZE];
+            ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (received == 0) {
+                result.failure = "connection closed by the server (client limit reached?)";
+                return false;
+            }
+            if (received < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                    return true;
+                }
+                result.failure = std::string("recv: ") + strerror(errno);
+                return false;
+            }
+            connection.in.append(buffer, static_cast<size_t>(received));
+
+            auto now = std::chrono::steady_clock::now();
+            uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(now - connection.sent).count();
+            size_t pos = 0;
+            while (connection.pending > 0) {
+                bool malformed = false;
+                size_t end = skipReply(connection.in, pos, malformed);
+                if (malformed) {
+                    result.failure = "malformed reply from the server";
+                    return false;
+                }
+                if (end == std::string_view::npos) {
+                    break;
+                }
+                if (connection.in[pos] == '-') {
+                    result.errors++;
+                }
+                pos = end;
+                connection.pending--;
+                result.completed++;
+                result.totalMicros += micros;
+                result.maxMicros = std::max(result.maxMicros, micros);
+                result.latency.record(micros);
+            }
+            connection.in.erase(0, pos);
+
+            if (connection.pending == 0 && !startBatch(connection, index)) {
+                active--;
+            }
+            return result.failure.empty();
+        }
+};
+
+struct TestResult {
+    std::string name;
+    double seconds = 0;
+    WorkerResult totals;
+};
+
+static bool runTest(const Options& options, const Workload& workload, TestResult& test) {
+    std::atomic<uint64_t> remaining{options.requests};
+    unsigned int threads = std::min(options.threads, options.clients);
+    std::random_device seeder;
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (unsigned int i = 0; i < threads; i++) {
+        unsigned int clients = options.clients / threads + (i < options.clients % threads ? 1 : 0);
+        workers.push_back(std::make_unique<Worker>(options, workload, remaining, seeder()));
+        std::string error;
+        if (!workers.back()->connect(clients, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return false;
+        }
+    }
+
+    // Connections are all open before the clock starts
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> running;
+    for (auto& worker : workers) {
+        running.emplace_back([&worker]() { worker->run(); });
+    }
+    for (std::thread& thread : running) {
+        thread.join();
+    }
+    test.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    test.name = workload.name;
+    for (auto& worker : workers) {
+        const WorkerResult& result = worker->getResult();
+        if (!result.failure.empty()) {
+            std::cerr << "Error during " << workload.name << ": " << result.failure << std::endl;
+            return false;
+        }
+        test.totals.completed += result.completed;
+        test.totals.errors += result.errors;
+        test.totals.totalMicros += result.totalMicros;
+        test.totals.maxMicros = std::max(test.totals.maxMicros, result.maxMicros);
+        test.totals.latency.merge(result.latency);
+    }
+    return true;
+}
+
+static double requestsPerSecond(const TestResult& test) {
+    return test.seconds > 0 ? test.totals.completed / test.seconds : 0;
+}
+
+static double averageMillis(const TestResult& test) {
+    return test.totals.completed > 0 ? test.totals.totalMicros / 1000.0 / test.totals.completed : 0;
+}
+
+// Histogram buckets report their upper bound, which can be past the slowest reply
+static double percentileMillis(const TestResult& test, double fraction) {
+    return std::min(test.totals.latency.percentile(fraction), test.totals.maxMicros) / 1000.0;
+}
+
+static void printText(const Options& options, const TestResult& test) {
+    printf("====== %s ======\n", test.name.c_str());
+    printf("  %llu requests completed in %.2f seconds\n", static_cast<unsigned long long>(test.totals.completed), test.seconds);
+    printf("  %u parallel clients, %u threads, pipeline %u, %u bytes payload, keyspace %llu\n",
+           options.clients, std::min(options.threads, options.clients), options.pipeline, options.dataSize,
+           static_cast<unsigned long long>(options.keyspace));
+    if (test.totals.errors > 0) {
+        printf("  %llu error replies\n", static_cast<unsigned long long>(test.totals.errors));
+    }
+    printf("  throughput: %.2f requests per second\n", requestsPerSecond(test));
+    printf("  latency (msec): avg=%.3f p50=%.3f p99=%.3f p99.9=%.3f max=%.3f\n\n",
+           averageMillis(test), percentileMillis(test, 0.5), percentileMillis(test, 0.99),
+           percentileMillis(test, 0.999), test.totals.maxMicros / 1000.0);
+}
+
+static void printCsvHeader() {
+    printf("\"test\",\"rps\",\"avg_latency_ms\",\"p50_latency_ms\",\"p99_latency_ms\",\"p999_latency_ms\",\"max_latency_ms\",\"errors\"\n");
+}
+
+static void printCsv(const TestResult& test) {
+    printf("\"%s\",\"%.2f\",\"%.3f\",\"%.3f\",\"%.3f\",\"%.3f\",\"%.3f\",\"%llu\"\n",
+           test.name.c_str(), requestsPerSecond(test), averageMillis(test), percentileMillis(test, 0.5),
+           percentileMillis(test, 0.99), percentileMillis(test, 0.999), test.totals.maxMicros / 1000.0,
+           static_cast<unsigned long long>(test.totals.errors));
+}
+
+static void printJson(const Options& options, const std::vector<TestResult>& tests) {
+    printf("{\n  \"host\": \"%s\",\n  \"port\": %d,\n  \"clients\": %u,\n  \"threads\": %u,\n"
+           "  \"pipeline\": %u,\n  \"keyspace\": %llu,\n  \"data_size\": %u,\n  \"tests\": [",
+           options.host.c_str(), options.port, options.clients, std::min(options.threads, options.clients),
+           options.pipeline, static_cast<unsigned long long>(options.keyspace), options.dataSize);
+    for (size_t i = 0; i < tests.size(); i++) {
+        const TestResult& test = tests[i];
+        printf("%s\n    {\"test\": \"%s\", \"requests\": %llu, \"errors\": %llu, \"seconds\": %.3f, \"rps\": %.2f, "
+               "\"latency_ms\": {\"avg\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}}",
+               i == 0 ? "" : ",", test.name.c_str(), static_cast<unsigned long long>(test.totals.completed),
+               static_cast<unsigned long long>(test.totals.errors), test.seconds, requestsPerSecond(test),
+               averageMillis(test), percentileMillis(test, 0.5), percentileMillis(test, 0.99),
+               percentileMillis(test, 0.999), test.totals.maxMicros / 1000.0);
+    }
+    printf("\n  ]\n}\n");
+}
+
+static bool parseNumber(const std::string& value, uint64_t& out) {
+    if (value.empty() || !std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return false;
+    }
+    try {
+        out = std::stoull(value);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+static bool parseNumber(const std::string& value, unsigned int& out, uint64_t max) {
+    uint64_t parsed;
+    if (!parseNumber(value, parsed) || parsed > max) {
+        return false;
+    }
+    out = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+static bool parseOptions(int argc, char* argv[], Options& options) {
+    std::string tests = "set,get,lpush,lpop,hset,hget";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--csv") {
+            options.format = OutputFormat::Csv;
+            continue;
+        }
+        if (arg == "--json") {
+            options.format = OutputFormat::Json;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for option " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+
+        bool valid;
+        unsigned int port = 0;
+        if (arg == "-h") {
+            options.host = value;
+            valid = true;
+        } else if (arg == "-p") {
+            valid = parseNumber(value, port, 65535);
+            options.port = static_cast<int>(port);
+        } else if (arg == "-c") {
+            valid = parseNumber(value, options.clients, 100000) && options.clients > 0;
+        } else if (arg == "-n") {
+            valid = parseNumber(value, options.requests);
+        } else if (arg == "-P") {
+            valid = parseNumber(value, options.pipeline, 100000) && options.pipeline > 0;
+        } else if (arg == "-r") {
+            valid = parseNumber(value, options.keyspace);
+        } else if (arg == "-d") {
+            valid = parseNumber(value, options.dataSize, 512 * 1024 * 1024);
+        } else if (arg == "--threads") {
+            valid = parseNumber(value, options.threads, 1024) && options.threads > 0;
+        } else if (arg == "-t") {
+            tests = value;
+            valid = true;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+        if (!valid) {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+
+    size_t start = 0;
+    while (start <= tests.size()) {
+        size_t end = tests.find(',', start);
+        if (end == std::string::npos) {
+            end = tests.size();
+        }
+        std::string name = tests.substr(start, end - start);
+        if (!findWorkload(name)) {
+            std::cerr << "Unknown test: " << name << std::endl;
+            return false;
+        }
+        options.tests.push_back(name);
+        start = end + 1;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [-h host] [-p port] [-c clients] [-n requests] [-P pipeline] [-r keyspace] [-d bytes] [-t set,get,lpush,lpop,hset,hget] [--threads n] [--csv | --json]" << std::endl;
+        return 1;
+    }
+
+    std::vector<TestResult> results;
+    if (options.format == OutputFormat::Csv) {
+        printCsvHeader();
+    }
+    for (const std::string& name : options.tests) {
+        TestResult test;
+        if (!runTest(options, *findWorkload(name), test)) {
+            return 1;
+        }
+        if (options.format == OutputFormat::Text) {
+            printText(options, test);
+        } else if (options.format == OutputFormat::Csv) {
+            printCsv(test);
+        }
+        fflush(stdout);
+        results.push_back(std::move(test));
+    }
+    if (options.format == OutputFormat::Json) {
+        printJson(options, results);
+    }
+    return 0;
+}
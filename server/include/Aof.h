@@ -0,0 +1,122 @@
+#ifndef AOF_H
+#define AOF_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+
+enum class FsyncPolicy {
+    Always,   // fsync before replies to the writes are sent
+    EverySec, // fsync from a background thread once a second
+    No        // leave it to the OS
+};
+
+// Append-only log of every change to the dataset, as RESP commands.
+//
+// Database appends the effect of each write while it still holds the shard
+// lock, so the log order matches the order the writes were applied in. Appends
+// only go to an in-memory buffer; each event loop calls flush() once per
+// iteration, before any reply is sent, which turns all the writes made since
+// the last flush into a single write() (and one fsync with "always").
+//
+// A background rewrite forks a child that dumps the dataset as commands,
+// while the parent keeps logging to the old file and to a rewrite buffer.
+// When the child is done the buffer is appended to its file, which is then
+// renamed over the log.
+class Aof {
+    private:
+        Aof() = default;
+        ~Aof() = default;
+        Aof(const Aof&) = delete;
+        Aof& operator=(const Aof&) = delete;
+
+        std::atomic<bool> enabled{false};
+        std::atomic<bool> writeOk{true}; // The last flush got the log to the file (and disk, with "always")
+
+        std::mutex mutex; // Guards everything below
+        std::string filename;
+        FsyncPolicy policy = FsyncPolicy::EverySec;
+        int fd = -1;
+        std::string buffer; // Appended since the last flush
+
+        bool rewriting = false; // Changes since the fork also go to rewriteBuffer
+        pid_t rewritePid = -1;
+        std::chrono::steady_clock::time_point rewriteStart;
+        std::string rewriteBuffer;
+
+        // Commands the calling thread appended, and how many of them its last flush covered
+        static inline thread_local uint64_t threadAppends = 0;
+        static inline thread_local uint64_t threadFlushed = 0;
+
+        std::thread fsyncThread; // Only with FsyncPolicy::EverySec
+        std::condition_variable fsyncWake;
+        bool stopping = false;
+
+        template <typename Range>
+        void appendCommand(const Range& args);
+        bool writeBuffer();
+        void setWriteStatus(bool ok);
+        void fsyncLoop();
+        void finishRewrite(pid_t pid);
+
+    public:
+        static Aof& getInstance();
+
+        // Replays the log into the Database. false if it is missing or corrupt;
+        // a command cut off at the end of the file is dropped with a warning.
+        bool load(const std::string& filename);
+
+        // Starts logging to filename (appending)
+        bool open(const std::string& filename, FsyncPolicy policy);
+
+        bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+        void append(std::initializer_list<std::string_view> args);
+        void append(const std::vector<std::string_view>& args);
+
+        // Group commit, called by every event loop once per iteration. Returns
+        // false when, with "always", the calling thread's writes could not be
+        // written and synced: their replies must not be sent. A failed write
+        // is retried from where it stopped on the next flush; until one
+        // succeeds lastWriteOk() is false and write commands are refused.
+        bool flush();
+        bool lastWriteOk() const { return writeOk.load(std::memory_order_relaxed); }
+
+        // Grows with every command the calling thread appends, so an event
+        // loop can tell which clients' commands were logged since its last flush
+        static uint64_t appendCount() { return threadAppends; }
+
+        // Starts a background rewrite; false if one is running or the log is off
+        bool backgroundRewrite();
+        bool rewriteInProgress();
+
+        // Reaps a finished rewrite child without blocking
+        void cron();
+
+        // Final flush and fsync; stops a running rewrite
+        void shutdown();
+
+        template <typename Range>
+        static void encodeCommand(std::string& out, const Range& args) {
+            out += '*';
+            out += std::to_string(args.size());
+            out += "\r\n";
+            for (std::string_view arg : args) {
+                out += '$';
+                out += std::to_string(arg.size());
+                out += "\r\n";
+                out.append(arg);
+                out += "\r\n";
+            }
+        }
+};
+
+#endif
@@ -2,58 +2,77 @@
 #define COMMAND_HANDLER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include "../include/Database.h"
 
 class CommandHandler {
 
-    private:
-
     public:
+        using Handler = std::string (CommandHandler::*)(const std::vector<std::string_view>&, Database&);
+
+        // One entry of the dispatch table
+        struct Command {
+            std::string_view name; // Lowercase
+            Handler handler;
+            int arity; // Arguments including the name, -N means at least N
+            bool denyOom = false; // Can grow the dataset, so refused over maxmemory when nothing can be evicted
+            bool write = false; // Changes the dataset, so refused while the append only file cannot be written
+        };
+
         CommandHandler();
 
-        std::string handleCommand(const std::vector<std::string>& parsedCommand);
-
-        std::string handlePing(const std::vector<std::string>& args, Database& db);
-        std::string handleEcho(const std::vector<std::string>& args, Database& db);
-        std::string handleFlushAll(const std::vector<std::string>& args, Database& db);
-        std::string handleType(const std::vector<std::string>& args, Database& db);
-        std::string handleDel(const std::vector<std::string>& args, Database& db);
-        std::string handleExists(const std::vector<std::string>& args, Database& db);
-        std::string handleRename(const std::vector<std::string>& args, Database& db);
-        std::string handleExpiry(const std::vector<std::string>& args, Database& db);
-
-        std::string handleSet(const std::vector<std::string>& args, Database& db);
-        std::string handleGet(const std::vector<std::string>& args, Database& db);
-        std::string handleKeys(const std::vector<std::string>& args, Database& db);
-
-        std::string handleLlen(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleLget(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleLpush(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleRpush(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleLpop(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleRpop(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleLrem(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleLindex(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleLset(const std::vector<std::string> &processedCommand, Database &db);
-
-        std::string handleHset(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleHget(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleHdel(const std::vector<std::string> &processedCommand, Database &db); 
-        std::string handleHgetall(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleHexists(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleHkeys(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleHvals(const std::vector<std::string> &processedCommand, Database &db);
-        std::string handleHlen(const std::vector<std::string> &processedCommand, Database &db);
-
-
-        bool parseRESP(const std::string& buffer, std::vector<std::string>& tokens, size_t& parsedLen);
-        bool parseArray(const std::string& buffer, std::vector<std::string>& tokens, size_t& pos);
-        bool parseBulkString(const std::string& buffer, std::vector<std::string>& tokens, size_t& pos);
-        bool parseSimpleString(const std::string& buffer, std::vector<std::string>& tokens, size_t& pos);
-        bool parseInteger(const std::string& buffer, std::vector<std::string>& tokens, size_t& pos);
-        bool parseError(const std::string& buffer, std::vector<std::string>& tokens, size_t& pos);
+        // Case-insensitive lookup in the dispatch table, nullptr if unknown
+        static const Command* lookupCommand(std::string_view name);
+
+        std::string handleCommand(const std::vector<std::string_view>& parsedCommand);
+
+        // Runs a command from the append only file: no stats, SLOWLOG or
+        // LATENCY samples, and no maxmemory or write checks
+        std::string replayCommand(const std::vector<std::string_view>& parsedCommand);
+
+        std::string handlePing(const std::vector<std::string_view>& args, Database& db);
+        std::string handleEcho(const std::vector<std::string_view>& args, Database& db);
+        std::string handleFlushAll(const std::vector<std::string_view>& args, Database& db);
+        std::string handleType(const std::vector<std::string_view>& args, Database& db);
+        std::string handleDel(const std::vector<std::string_view>& args, Database& db);
+        std::string handleExists(const std::vector<std::string_view>& args, Database& db);
+        std::string handleRename(const std::vector<std::string_view>& args, Database& db);
+        std::string handleExpiry(const std::vector<std::string_view>& args, Database& db);
+        std::string handlePexpireat(const std::vector<std::string_view>& args, Database& db);
+        std::string handleBgrewriteaof(const std::vector<std::string_view>& args, Database& db);
+        std::string handleBgsave(const std::vector<std::string_view>& args, Database& db);
+        std::string handleLastsave(const std::vector<std::string_view>& args, Database& db);
+        std::string handleInfo(const std::vector<std::string_view>& args, Database& db);
+        std::string handleMemory(const std::vector<std::string_view>& args, Database& db);
+        std::string handleSlowlog(const std::vector<std::string_view>& args, Database& db);
+        std::string handleLatency(const std::vector<std::string_view>& args, Database& db);
+
+        std::string handleSet(const std::vector<std::string_view>& args, Database& db);
+        std::string handleGet(const std::vector<std::string_view>& args, Database& db);
+        std::string handleKeys(const std::vector<std::string_view>& args, Database& db);
+        std::string handleScan(const std::vector<std::string_view>& args, Database& db);
+
+        std::string handleLlen(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleLget(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleLpush(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleRpush(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleLpop(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleRpop(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleLrem(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleLindex(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleLset(const std::vector<std::string_view> &processedCommand, Database &db);
+
+        std::string handleHset(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleHget(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleHdel(const std::vector<std::string_view> &processedCommand, Database &db); 
+        std::string handleHgetall(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleHexists(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleHkeys(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleHvals(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleHlen(const std::vector<std::string_view> &processedCommand, Database &db);
+        std::string handleHscan(const std::vector<std::string_view> &processedCommand, Database &db);
 
 };
 
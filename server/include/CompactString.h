@@ -0,0 +1,62 @@
+#ifndef COMPACT_STRING_H
+#define COMPACT_STRING_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "Encoding.h"
+
+// Immutable string for keys and string values, one word wide. Up to 7 bytes
+// live in the word itself; anything longer is a [varint len][bytes] block
+// from Slab. A 20-byte key costs 8 + 24 bytes this way, against 32 for a
+// std::string plus a 32-byte malloc chunk.
+class CompactString {
+    public:
+        static constexpr size_t INLINE_CAPACITY = sizeof(uintptr_t) - 1;
+
+        CompactString() = default;
+        explicit CompactString(std::string_view value) { assign(value); }
+        ~CompactString() { release(); }
+
+        CompactString(const CompactString& other) { assign(other.view()); }
+        CompactString& operator=(const CompactString& other);
+        CompactString(CompactString&& other) noexcept : bits(other.bits) { other.bits = 0; }
+        CompactString& operator=(CompactString&& other) noexcept;
+
+        std::string_view view() const {
+            if (bits == 0) {
+                return {};
+            }
+            if (isInline()) {
+                return std::string_view(reinterpret_cast<const char*>(&bits) + 1, (bits & 0xFF) >> 1);
+            }
+            const char* block = reinterpret_cast<const char*>(bits);
+            uint64_t len;
+            size_t header = decodeVarint(block, block + 10, len);
+            return std::string_view(block + header, len);
+        }
+        operator std::string_view() const { return view(); }
+        size_t size() const { return view().size(); }
+        bool empty() const { return bits == 0; }
+
+        // Heap bytes behind the string, 0 when it is stored inline
+        size_t memoryUsage() const;
+
+        friend bool operator==(const CompactString& a, const CompactString& b) { return a.view() == b.view(); }
+        friend bool operator==(const CompactString& a, std::string_view b) { return a.view() == b; }
+
+    private:
+        // 0: empty. Low bit set: inline, with the length in the low byte
+        // above the tag bit and the bytes after it. Otherwise: the block.
+        uintptr_t bits = 0;
+
+        static_assert(std::endian::native == std::endian::little, "The inline bytes follow the tag byte in memory");
+
+        bool isInline() const { return bits & 1; }
+        void assign(std::string_view value);
+        void release();
+};
+
+#endif
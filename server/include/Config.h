@@ -0,0 +1,49 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <string>
+#include <vector>
+#include "Aof.h"
+#include "Persistence.h"
+#include "Logger.h"
+#include "Reactor.h"
+#include "Database.h"
+
+// Startup options. The first positional argument is still the port, so
+// `./server 6380` keeps working; everything else is passed as `--name value`.
+struct Config {
+    int port = 6379;
+    unsigned int threads = 0; // Event-loop threads, 0 = one per core
+    IoBackend ioBackend = IoBackend::Epoll; // io_uring falls back to epoll if the kernel lacks it
+
+    // Hashes stay in the packed encoding up to this many fields, each field
+    // and value no longer than hashMaxPackedValue bytes
+    unsigned int hashMaxPackedEntries = 128;
+    unsigned int hashMaxPackedValue = 64;
+
+    // Memory limit for the dataset, 0 = none, and what to evict once it is reached
+    size_t maxMemory = 0;
+    EvictionPolicy maxMemoryPolicy = EvictionPolicy::NoEviction;
+
+    // Background snapshot triggers, checked by the event loop; empty disables them
+    std::vector<SaveRule> saveRules = {{3600, 1}, {300, 100}, {60, 10000}};
+
+    // Append-only log of writes; when on, it is replayed at startup instead of the snapshot
+    bool appendOnly = false;
+    std::string appendFilename = "appendonly.aof";
+    FsyncPolicy appendFsync = FsyncPolicy::EverySec;
+
+    // Commands taking at least this many microseconds go to SLOWLOG (0: all, -1: none), which keeps the last slowlogMaxLen
+    long long slowlogLogSlowerThan = 10000;
+    unsigned int slowlogMaxLen = 128;
+
+    // Internal events taking at least this many milliseconds are kept for LATENCY, 0 = off
+    unsigned int latencyMonitorThreshold = 0;
+
+    // Messages below this level are skipped; debug needs a LOG_MIN_LEVEL=0 build
+    LogLevel logLevel = LogLevel::Info;
+};
+
+bool parseConfig(int argc, char* argv[], Config& config);
+
+#endif
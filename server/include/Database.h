@@ -3,10 +3,27 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <functional>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <optional>
+#include <sys/types.h>
+
+#include "Dict.h"
+#include "StringMap.h"
+#include "CompactString.h"
+#include "Slab.h"
+#include "Object.h"
+
+class SnapshotReader;
+
+// What to drop once maxmemory is reached
+enum class EvictionPolicy {NoEviction, AllKeysLru, AllKeysLfu, VolatileTtl};
 
 class Database {
     private:
@@ -15,55 +32,177 @@ class Database {
         Database(const Database&) = delete; // Prevent copy construction
         Database& operator=(const Database&) = delete; // Prevent assignment
 
-        std::mutex db_mutex; // Mutex for thread safety
+        // The keyspace is split into hash-partitioned shards, each with its own
+        // lock and its own map. Single-key operations only lock their shard;
+        // whole-keyspace operations (KEYS, FLUSHALL, dump/load) walk the shards in turn.
+        // Keys are CompactStrings and the nodes come from Slab, so a key
+        // costs no more than its bytes rounded up to 8 plus the node itself
+        using Keyspace = Dict<CompactString, Object>;
+        using KeyEntry = Keyspace::value_type;
+
+        struct alignas(64) Shard {
+            std::mutex mutex; // Mutex for thread safety
+
+            Keyspace keyspace; // Every key, whatever its type
+
+            // Min-heap on expiresAt over the keys with a TTL, so expired keys
+            // are found without scanning. It points at the keyspace nodes, which
+            // stay put across rehashes, and each Object records its slot so a
+            // delete or TTL change fixes the heap in place.
+            std::vector<KeyEntry*> expiryHeap;
+
+            std::atomic<uint64_t> dirty{0}; // Writes applied, only ever grows
+
+            // Approximate bytes held by the keys (see entryMemory). Written
+            // under the mutex, read without it.
+            std::atomic<size_t> usedMemory{0};
+        };
+
+        static constexpr size_t SHARD_COUNT = 64;
+        static constexpr size_t EXPIRE_BATCH = 64; // Max keys expired per shard lock hold
+        static constexpr size_t REHASH_BATCH = 256; // Max buckets rehashed per shard lock hold
+        static constexpr size_t RESTORE_BATCH = 256; // Keys inserted per shard lock hold while loading
+        static constexpr size_t EVICTION_SAMPLES = 5; // Keys sampled per shard
+        static constexpr size_t EVICTION_SHARDS = 4; // Shards whose candidates are compared per eviction
+        static constexpr size_t EVICTION_PROBES = 64; // Buckets tried while collecting the samples
+        static constexpr unsigned SCAN_SHARD_SHIFT = 58; // SCAN cursors hold the shard in the top log2(SHARD_COUNT) bits
+        std::array<Shard, SHARD_COUNT> shards;
+        std::atomic<size_t> expireCursor{0}; // Next shard for the active expiry cycle
+
+        // Set once at startup, after the dataset has been loaded
+        size_t maxMemory = 0; // 0 = unlimited
+        EvictionPolicy evictionPolicy = EvictionPolicy::NoEviction;
+        std::atomic<uint64_t> evictedKeys{0};
+
+        // Set while the append only file is replayed, see beginLoading
+        std::atomic<bool> loading{false};
+
+        Shard& shardFor(std::string_view key);
+        bool isExpired(const Object& object) const; // Never while loading
 
-        std::unordered_map<std::string, std::string> keyValueStore; // Key-Value pairs
-        std::unordered_map<std::string, std::vector<std::string>> listStore;
-        std::unordered_map<std::string, std::unordered_map<std::string, std::string>> hashStore;
+        // Caller must hold shard.mutex for all of these
+        Object* lookup(Shard& shard, std::string_view key);
+        template <typename T>
+        T* lookupAs(Shard& shard, std::string_view key);
+        template <typename T>
+        T* lookupOrCreate(Shard& shard, std::string_view key);
+        size_t purgeExpired(Shard& shard, size_t limit);
+        void setExpiry(Shard& shard, KeyEntry& entry, Object::Clock::time_point when);
+        void removeKey(Shard& shard, Keyspace::iterator it);
+        void expireKey(Shard& shard, Keyspace::iterator it);
+        void chargeMemory(Shard& shard, size_t before, size_t after);
+        int64_t evictionScore(const Object& object, uint32_t now) const;
+        KeyEntry* evictionCandidate(Shard& shard, uint32_t now);
+        bool evictOne(); // Locks one shard at a time
 
-        std::unordered_map<std::string, std::chrono::steady_clock::time_point> expiryStore; // Store for key expirations
+        void propagate(Shard& shard, std::initializer_list<std::string_view> args);
+        void propagate(Shard& shard, const std::vector<std::string_view>& args);
+
+        void restoreKey(CompactString key, Object object); // Locks the key's shard
+        void insertRestored(Shard& shard, CompactString key, Object object); // Caller holds shard.mutex
+        bool loadRecords(SnapshotReader& reader, std::optional<uint64_t> count); // Locks shards per batch
+        bool loadLegacyDatabase(const std::string& filename);
+        bool writeSnapshot(const std::string& filename, bool lockShards);
+
+        void heapPush(Shard& shard, KeyEntry& entry);
+        void heapRemove(Shard& shard, uint32_t index);
+        void heapFix(Shard& shard, uint32_t index);
+        void heapSet(Shard& shard, uint32_t index, KeyEntry* entry);
 
     public:
         static Database& getInstance();
 
         
         bool dumpDatabase(const std::string& filename);
+        // Forks a child that writes a point-in-time snapshot of the dataset
+        // and exits. Returns the child's pid, or -1 if fork failed.
+        pid_t forkSnapshot(const std::string& filename);
+
+        // Forks with every shard locked, so the child starts from a consistent
+        // dataset. The child runs childMain and exits with its result; the
+        // parent runs onForked(pid) before the locks are released.
+        pid_t forkConsistent(const std::function<bool()>& childMain,
+                             const std::function<void(pid_t)>& onForked = nullptr);
+
+        // Writes the dataset as commands for an append-only log rewrite. Only
+        // safe in a child started by forkConsistent.
+        bool writeCommandLog(const std::string& filename);
         bool loadDatabase(const std::string& filename);
 
+        // No key expires while the append only file is replayed. Keys whose
+        // TTL passed meanwhile are deleted, and logged, once the server runs.
+        void beginLoading();
+        void endLoading();
+
         bool flushAll();
 
-        bool set(const std::string& key, const std::string& value);
-        std::string get(const std::string& key);
-        std::vector<std::string> keys();
-        std::string type(const std::string& key);
-        bool del(const std::string& key);
-        bool exists(const std::string& key);
-        bool rename(const std::string& oldKey, const std::string& newKey);
+        // Total writes since startup; the save rules compare it against its value at the last save
+        uint64_t dirtyCount();
+
+        // Keys, and keys with a TTL, expired ones not yet removed included
+        void keyspaceCounts(size_t& keys, size_t& expires);
+
+        void setMaxMemory(size_t bytes, EvictionPolicy policy);
+        size_t getMaxMemory() const { return maxMemory; }
+        EvictionPolicy getEvictionPolicy() const { return evictionPolicy; }
+        uint64_t evictedCount() const { return evictedKeys.load(std::memory_order_relaxed); }
+        size_t usedMemory();
+
+        // Evicts keys per the policy until used memory is back under
+        // maxmemory. Called before commands that can grow the dataset; false
+        // if that is not possible, and the command should be refused.
+        bool freeMemoryIfNeeded();
+
+        // Approximate bytes key costs, nullopt if it does not exist
+        std::optional<size_t> memoryUsage(std::string_view key);
+
+        bool set(std::string_view key, std::string_view value);
+        std::string get(std::string_view key);
+        std::vector<std::string> keys(std::string_view pattern = "*");
+
+        // One step of a SCAN walk: appends the live keys matching pattern
+        // out of about `count` visited and returns the cursor to continue
+        // from, 0 once every shard has been walked. Holds one shard lock at a time.
+        uint64_t scan(uint64_t cursor, size_t count, std::string_view pattern, std::vector<std::string>& keys);
+        std::string type(std::string_view key);
+        bool del(std::string_view key);
+        bool exists(std::string_view key);
+        bool rename(std::string_view oldKey, std::string_view newKey);
+
+        bool expiry(std::string_view key, int seconds);
+        bool expireAt(std::string_view key, uint64_t unixMillis);
 
-        bool expiry(const std::string& key, int seconds);
+        // Deletes expired keys for at most `budget`, resuming where the last
+        // call stopped. Driven from the event loop; returns the keys removed.
+        size_t activeExpireCycle(std::chrono::microseconds budget);
 
-        void purgeExpired();
+        // Moves shard keyspaces that are being resized along for at most
+        // `budget`, so resizes finish while the server is idle. Driven from
+        // the event loop; returns true if some are still resizing.
+        bool incrementalRehash(std::chrono::microseconds budget);
 
         // List Operations
-        ssize_t llen(const std::string& key);
-        std::string lindex(const std::string& key, int index);
-        void lpush(const std::string& key, const std::string& value);
-        void rpush(const std::string& key, const std::string& value);
-        std::string lpop(const std::string& key);
-        std::string rpop(const std::string& key);
-        int lrem(const std::string& key, int count, const std::string& value);
-        bool lset(const std::string& key, int index, const std::string& value);
-        std::vector<std::string> lget(const std::string& key);
+        ssize_t llen(std::string_view key);
+        std::string lindex(std::string_view key, int index);
+        bool lpush(std::string_view key, std::string_view value); // False if key holds another type
+        bool rpush(std::string_view key, std::string_view value);
+        std::string lpop(std::string_view key);
+        std::string rpop(std::string_view key);
+        int lrem(std::string_view key, int count, std::string_view value);
+        bool lset(std::string_view key, int index, std::string_view value);
+        std::vector<std::string> lget(std::string_view key);
 
         // Hash Operations
-        size_t hset(const std::vector<std::string>& args);
-        std::string hget(const std::string& key, const std::string& field);
-        size_t hdel(const std::string& key, const std::string& field);
-        bool hexists(const std::string& key, const std::string& field);
-        std::unordered_map<std::string, std::string> hgetall(const std::string& key);
-        std::vector<std::string> hkeys(const std::string& key);
-        std::vector<std::string> hvals(const std::string& key);
-        size_t hlen(const std::string& key);
+        size_t hset(const std::vector<std::string_view>& args); // 0 if key holds another type
+        std::string hget(std::string_view key, std::string_view field);
+        size_t hdel(std::string_view key, std::string_view field);
+        bool hexists(std::string_view key, std::string_view field);
+        StringMap<std::string> hgetall(std::string_view key);
+        uint64_t hscan(std::string_view key, uint64_t cursor, size_t count, std::string_view pattern,
+                       std::vector<std::pair<std::string, std::string>>& fields); // Same contract as scan
+        std::vector<std::string> hkeys(std::string_view key);
+        std::vector<std::string> hvals(std::string_view key);
+        size_t hlen(std::string_view key);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,423 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "StringMap.h"
+#include "Slab.h"
+
+// Chained hash table with power-of-two bucket arrays, used for the keyspace
+// and for hashes past the packed encoding. It has the std::unordered_map
+// subset the rest of the code uses, nodes that never move (so pointers to
+// entries stay valid until they are erased) and come from Slab, and a SCAN
+// cursor that stays valid when the table is resized between calls.
+//
+// Resizing is incremental: a second bucket array is allocated and every
+// operation moves a few buckets over, plus whatever rehash() is given from
+// the event loop, so no single call pays for moving the whole table.
+template <typename Key, typename Value>
+class Dict {
+    public:
+        using value_type = std::pair<const Key, Value>;
+
+    private:
+        // next, hash and the key lead the node, so walking a chain touches
+        // one cache line per node until the key matches
+        struct Node {
+            Node* next;
+            size_t hash; // Kept so resizing never rehashes a key
+            value_type entry;
+
+            template <typename K, typename V>
+            Node(size_t hash, K&& key, V&& value)
+                : next(nullptr), hash(hash), entry(std::forward<K>(key), std::forward<V>(value)) {}
+        };
+
+        struct Table {
+            Node** buckets = nullptr;
+            size_t mask = 0; // Bucket count - 1, the count is 0 while buckets is null
+            size_t used = 0;
+
+            size_t size() const { return buckets == nullptr ? 0 : mask + 1; }
+        };
+
+        static constexpr size_t INITIAL_BUCKETS = 4;
+        static constexpr size_t OPERATION_REHASH_BUCKETS = 4; // Buckets moved by each find, emplace and erase
+        static constexpr size_t EMPTY_VISITS_PER_BUCKET = 10; // Empty buckets skipped per bucket of rehash work
+        static constexpr size_t NOT_REHASHING = SIZE_MAX;
+
+        // tables[1] only exists while rehashing, when the buckets of
+        // tables[0] below rehashIndex have all been moved to it
+        Table tables[2];
+        size_t rehashIndex = NOT_REHASHING;
+
+        static size_t hashOf(std::string_view key) { return StringHash{}(key); }
+
+        static Node* findInTable(const Table& table, std::string_view key, size_t hash) {
+            if (table.buckets == nullptr) {
+                return nullptr;
+            }
+            for (Node* node = table.buckets[hash & table.mask]; node != nullptr; node = node->next) {
+                if (node->hash == hash && std::string_view(node->entry.first) == key) {
+                    return node;
+                }
+            }
+            return nullptr;
+        }
+
+        // Sets table to the one holding the node, if any
+        Node* findNode(std::string_view key, size_t hash, size_t& table) const {
+            for (table = 0; table <= (isRehashing() ? 1 : 0); table++) {
+                if (Node* node = findInTable(tables[table], key, hash)) {
+                    return node;
+                }
+            }
+            return nullptr;
+        }
+
+        static Table allocateTable(size_t bucketCount) {
+            Table table;
+            table.buckets = SlabAllocator<Node*>().allocate(bucketCount);
+            for (size_t i = 0; i < bucketCount; i++) {
+                table.buckets[i] = nullptr;
+            }
+            table.mask = bucketCount - 1;
+            return table;
+        }
+
+        static void freeTable(Table& table) {
+            if (table.buckets != nullptr) {
+                SlabAllocator<Node*>().deallocate(table.buckets, table.size());
+            }
+            table = Table();
+        }
+
+        // Starts moving to bucketCount buckets, a power of two. An empty
+        // table is replaced on the spot.
+        void startResize(size_t bucketCount) {
+            if (tables[0].used == 0) {
+                freeTable(tables[0]);
+                tables[0] = allocateTable(bucketCount);
+                return;
+            }
+            tables[1] = allocateTable(bucketCount);
+            rehashIndex = 0;
+        }
+
+        // Grows at load factor 1 and shrinks below 1/8, to half full
+        void resizeIfNeeded() {
+            if (isRehashing()) {
+                return;
+            }
+            size_t bucketCount = tables[0].size();
+            if (tables[0].used >= bucketCount) {
+                startResize(bucketCount == 0 ? INITIAL_BUCKETS : 2 * bucketCount);
+            } else if (bucketCount > INITIAL_BUCKETS && tables[0].used * 8 < bucketCount) {
+                startResize(roundUp(2 * tables[0].used));
+            }
+        }
+
+        static size_t roundUp(size_t n) {
+            size_t bucketCount = INITIAL_BUCKETS;
+            while (bucketCount < n) {
+                bucketCount *= 2;
+            }
+            return bucketCount;
+        }
+
+        void insertNode(Table& table, Node* node) {
+            Node*& head = table.buckets[node->hash & table.mask];
+            node->next = head;
+            head = node;
+            table.used++;
+        }
+
+        // Takes node out of whichever chain holds it
+        void unlinkNode(Node* node) {
+            for (size_t i = 0; i <= (isRehashing() ? 1 : 0); i++) {
+                Table& table = tables[i];
+                if (table.buckets == nullptr) {
+                    continue;
+                }
+                for (Node** link = &table.buckets[node->hash & table.mask]; *link != nullptr; link = &(*link)->next) {
+                    if (*link == node) {
+                        *link = node->next;
+                        table.used--;
+                        return;
+                    }
+                }
+            }
+        }
+
+        static void destroyNode(Node* node) {
+            node->~Node();
+            SlabAllocator<Node>().deallocate(node, 1);
+        }
+
+        static uint64_t reverseBits(uint64_t value) {
+            uint64_t result = 0;
+            for (int i = 0; i < 64; i++) {
+                result = (result << 1) | (value & 1);
+                value >>= 1;
+            }
+            return result;
+        }
+
+        // Advances a reverse-binary cursor over the buckets under mask
+        static uint64_t nextCursor(uint64_t cursor, size_t mask) {
+            cursor |= ~static_cast<uint64_t>(mask);
+            return reverseBits(reverseBits(cursor) + 1);
+        }
+
+        template <typename Fn>
+        static void forEachInChain(Node* node, Fn& fn) {
+            while (node != nullptr) {
+                Node* next = node->next;
+                fn(node->entry);
+                node = next;
+            }
+        }
+
+    public:
+        template <bool Const>
+        class Iterator {
+            friend class Dict;
+            using DictType = std::conditional_t<Const, const Dict, Dict>;
+
+            DictType* dict = nullptr;
+            size_t table = 0;
+            size_t bucket = 0;
+            Node* node = nullptr;
+
+            Iterator(DictType* dict, size_t table, size_t bucket, Node* node)
+                : dict(dict), table(table), bucket(bucket), node(node) {}
+
+            void skipEmpty() {
+                while (node == nullptr && table < 2) {
+                    if (++bucket >= dict->tables[table].size()) {
+                        if (++table == 2 || !dict->isRehashing()) {
+                            return;
+                        }
+                        bucket = 0;
+                    }
+                    node = dict->tables[table].buckets[bucket];
+                }
+            }
+
+            public:
+                using reference = std::conditional_t<Const, const value_type&, value_type&>;
+                using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+                Iterator() = default;
+                operator Iterator<true>() const { return Iterator<true>(dict, table, bucket, node); }
+
+                reference operator*() const { return node->entry; }
+                pointer operator->() const { return &node->entry; }
+                Iterator& operator++() {
+                    node = node->next;
+                    skipEmpty();
+                    return *this;
+                }
+                bool operator==(const Iterator& other) const { return node == other.node; }
+        };
+        using iterator = Iterator<false>;
+        using const_iterator = Iterator<true>;
+
+        Dict() = default;
+        ~Dict() {
+            clear();
+        }
+
+        Dict(const Dict& other) {
+            reserve(other.size());
+            for (const auto& entry : other) {
+                emplace(entry.first, entry.second);
+            }
+        }
+        Dict& operator=(const Dict&) = delete;
+
+        size_t size() const { return tables[0].used + tables[1].used; }
+        bool empty() const { return size() == 0; }
+        bool isRehashing() const { return rehashIndex != NOT_REHASHING; }
+
+        // Buckets of both arrays while rehashing, numbered by forEachInBucket
+        size_t bucketCount() const { return tables[0].size() + tables[1].size(); }
+
+        // Iteration does no rehash work; the Dict must not be modified while
+        // an iterator is in use
+        iterator begin() {
+            iterator it(this, 0, 0, tables[0].buckets != nullptr ? tables[0].buckets[0] : nullptr);
+            it.skipEmpty();
+            return it;
+        }
+        iterator end() { return iterator(this, 2, 0, nullptr); }
+        const_iterator begin() const {
+            const_iterator it(this, 0, 0, tables[0].buckets != nullptr ? tables[0].buckets[0] : nullptr);
+            it.skipEmpty();
+            return it;
+        }
+        const_iterator end() const { return const_iterator(this, 2, 0, nullptr); }
+
+        // Also moves a few buckets along if a resize is in progress
+        iterator find(std::string_view key) {
+            rehash(OPERATION_REHASH_BUCKETS);
+            const_iterator it = std::as_const(*this).find(key);
+            return iterator(this, it.table, it.bucket, it.node);
+        }
+        const_iterator find(std::string_view key) const {
+            size_t hash = hashOf(key);
+            size_t table;
+            Node* node = findNode(key, hash, table);
+            return node != nullptr ? const_iterator(this, table, hash & tables[table].mask, node) : end();
+        }
+
+        // Inserts unless key is present; returns the entry for key either way
+        template <typename K, typename V>
+        std::pair<iterator, bool> emplace(K&& key, V&& value) {
+            rehash(OPERATION_REHASH_BUCKETS);
+            size_t hash = hashOf(key);
+            size_t table;
+            if (Node* node = findNode(key, hash, table)) {
+                return {iterator(this, table, hash & tables[table].mask, node), false};
+            }
+            resizeIfNeeded();
+            table = isRehashing() ? 1 : 0; // New keys go straight to the new array
+            Node* node = new (SlabAllocator<Node>().allocate(1)) Node(hash, std::forward<K>(key), std::forward<V>(value));
+            insertNode(tables[table], node);
+            return {iterator(this, table, hash & tables[table].mask, node), true};
+        }
+
+        void erase(iterator it) {
+            unlinkNode(it.node);
+            destroyNode(it.node);
+            rehash(OPERATION_REHASH_BUCKETS);
+            resizeIfNeeded();
+        }
+
+        // Drops every entry and the bucket arrays
+        void clear() {
+            for (Table& table : tables) {
+                for (size_t i = 0; i < table.size(); i++) {
+                    Node* node = table.buckets[i];
+                    while (node != nullptr) {
+                        Node* next = node->next;
+                        destroyNode(node);
+                        node = next;
+                    }
+                }
+                freeTable(table);
+            }
+            rehashIndex = NOT_REHASHING;
+        }
+
+        // Sizes the buckets for n entries up front, finishing any resize first
+        void reserve(size_t n) {
+            while (rehash(SIZE_MAX)) {
+            }
+            size_t target = roundUp(n);
+            if (target > tables[0].size()) {
+                startResize(target);
+            }
+        }
+
+        // Moves up to `buckets` buckets of an ongoing resize to the new array,
+        // skipping at most EMPTY_VISITS_PER_BUCKET empty ones for each.
+        // Returns true while there is more to move.
+        bool rehash(size_t buckets) {
+            if (!isRehashing()) {
+                return false;
+            }
+            size_t emptyVisits = buckets > SIZE_MAX / EMPTY_VISITS_PER_BUCKET ? SIZE_MAX : buckets * EMPTY_VISITS_PER_BUCKET;
+            Table& from = tables[0];
+            for (; buckets > 0 && from.used > 0; buckets--) {
+                while (from.buckets[rehashIndex] == nullptr) {
+                    rehashIndex++;
+                    if (--emptyVisits == 0) {
+                        return true;
+                    }
+                }
+                Node* node = from.buckets[rehashIndex];
+                while (node != nullptr) {
+                    Node* next = node->next;
+                    insertNode(tables[1], node);
+                    from.used--;
+                    node = next;
+                }
+                from.buckets[rehashIndex++] = nullptr;
+            }
+            if (from.used > 0) {
+                return true;
+            }
+            freeTable(from);
+            tables[0] = tables[1];
+            tables[1] = Table();
+            rehashIndex = NOT_REHASHING;
+            return false;
+        }
+
+        // Calls fn(value_type&) for each entry in one bucket, 0 to
+        // bucketCount() - 1, for sampling
+        template <typename Fn>
+        void forEachInBucket(size_t bucket, Fn fn) {
+            if (bucket < tables[0].size()) {
+                forEachInChain(tables[0].buckets[bucket], fn);
+            } else {
+                forEachInChain(tables[1].buckets[bucket - tables[0].size()], fn);
+            }
+        }
+
+        // One step of a SCAN walk (start it with cursor 0): passes whole
+        // buckets to fn(value_type&) until limit entries or 10 * limit
+        // buckets have been seen, and returns the next cursor, 0 once the
+        // walk is complete. The cursor counts with its bits reversed, so
+        // when the table doubles or halves between calls the buckets already
+        // walked map onto a prefix of the new order and no entry present for
+        // the whole walk is missed, though some may come back twice. During
+        // a resize each bucket of the smaller array is visited together with
+        // the buckets of the larger one it expands to. The cursor always
+        // stays below the larger bucket count.
+        template <typename Fn>
+        uint64_t scan(uint64_t cursor, size_t limit, Fn fn) {
+            if (empty()) {
+                return 0;
+            }
+            size_t visited = 0;
+            auto count = [&](value_type& entry) {
+                fn(entry);
+                visited++;
+            };
+            size_t maxExamined = limit > SIZE_MAX / 10 ? SIZE_MAX : limit * 10; // limit comes from a client's COUNT
+            for (size_t examined = 0; examined < maxExamined && visited < limit; examined++) {
+                if (!isRehashing()) {
+                    forEachInChain(tables[0].buckets[cursor & tables[0].mask], count);
+                    cursor = nextCursor(cursor, tables[0].mask);
+                } else {
+                    const Table* small = &tables[0];
+                    const Table* large = &tables[1];
+                    if (small->size() > large->size()) {
+                        std::swap(small, large);
+                    }
+                    forEachInChain(small->buckets[cursor & small->mask], count);
+                    do { // Every bucket of large that cursor's bucket of small splits into
+                        forEachInChain(large->buckets[cursor & large->mask], count);
+                        cursor = nextCursor(cursor, large->mask);
+                    } while (cursor & (small->mask ^ large->mask));
+                }
+                if (cursor == 0) {
+                    break;
+                }
+            }
+            return cursor;
+        }
+        template <typename Fn>
+        uint64_t scan(uint64_t cursor, size_t limit, Fn fn) const {
+            return const_cast<Dict*>(this)->scan(cursor, limit, [&fn](const value_type& entry) { fn(entry); });
+        }
+};
+
+#endif
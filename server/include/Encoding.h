@@ -0,0 +1,48 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// LEB128 varints: 7 bits per byte, high bit set on every byte but the last.
+// Shared by the packed in-memory encodings and the snapshot format.
+
+inline size_t varintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+inline size_t encodeVarint(uint64_t value, char* out) {
+    size_t i = 0;
+    while (value >= 0x80) {
+        out[i++] = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out[i++] = static_cast<char>(value);
+    return i;
+}
+
+inline void appendVarint(std::string& out, uint64_t value) {
+    char buffer[10];
+    out.append(buffer, encodeVarint(value, buffer));
+}
+
+// Decodes a varint from [p, end). Returns the bytes consumed, 0 if truncated or too long.
+inline size_t decodeVarint(const char* p, const char* end, uint64_t& value) {
+    value = 0;
+    for (size_t i = 0; i < 10 && p + i < end; i++) {
+        uint8_t byte = static_cast<uint8_t>(p[i]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef EPOLL_REACTOR_H
+#define EPOLL_REACTOR_H
+
+#include <unordered_map>
+#include <vector>
+#include "../include/Reactor.h"
+
+// Edge-triggered epoll backend: recv on readiness, replies written straight
+// to the socket, EPOLLOUT armed only when the socket buffer is full.
+class EpollReactor : public Reactor {
+    private:
+        const int BUFFER_SIZE = 4096; // Size of the buffer for reading data
+        const size_t MAX_READ_SIZE = 1024 * 1024; // Largest single recv while a big bulk string arrives
+
+        struct EpollClient : Client {
+            size_t writePos = 0; // Start of the unsent data in writeBuffer
+            bool writeArmed = false; // EPOLLOUT registered because the socket was full
+        };
+
+        int serverSocket = -1;
+        int epoll_fd = -1;
+        std::unordered_map<int, EpollClient> clients;
+        std::vector<int> pendingWrites; // Clients with replies to send
+
+        void acceptClients();
+        bool readFromClient(EpollClient& client);
+        void queueWrite(Client& client) override;
+        void flushPendingWrites(bool logSynced);
+        bool writeToClient(EpollClient& client);
+        bool setClientEvents(int clientFd, uint32_t events);
+        void closeClient(int clientFd);
+
+    public:
+        EpollReactor(int id, int port, std::atomic<bool>& running);
+        ~EpollReactor() override;
+
+        bool setup() override;
+        void run() override;
+};
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef GLOB_H
+#define GLOB_H
+
+#include <string_view>
+
+// Redis-style glob match for KEYS and SCAN MATCH: * (any run), ? (any one
+// byte), [abc], [a-z], [^...] and \ to escape. Runs in O(pattern * text)
+// at worst, however many stars the pattern has.
+bool globMatch(std::string_view pattern, std::string_view text);
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "CompactString.h"
+#include "Dict.h"
+#include "StringMap.h"
+
+// Hash encoding used by Database. Small hashes are a single packed buffer of
+// [varint len][field][varint len][value] pairs searched linearly, which costs
+// a few bytes of framing per field instead of a hash node and two strings.
+// The first write that goes past maxPackedEntries fields, or stores a field
+// or value longer than maxPackedValue bytes, converts it to a Dict for good.
+class Hash {
+    public:
+        Hash() = default;
+
+        Hash(const Hash& other);
+        Hash& operator=(const Hash& other);
+        Hash(Hash&& other) noexcept = default;
+        Hash& operator=(Hash&& other) noexcept = default;
+
+        size_t size() const { return table ? table->size() : count; }
+        bool empty() const { return size() == 0; }
+        bool isPacked() const { return !table; }
+
+        // Approximate heap bytes held, O(1)
+        size_t memoryUsage() const;
+
+        bool get(std::string_view field, std::string& value) const;
+        bool contains(std::string_view field) const;
+        bool set(std::string_view field, std::string_view value); // Returns true if the field is new
+        bool erase(std::string_view field);
+
+        // Calls fn(std::string_view field, std::string_view value) for every field
+        template <typename Fn>
+        void forEach(Fn fn) const {
+            if (table) {
+                for (const auto& entry : *table) {
+                    fn(std::string_view(entry.first), std::string_view(entry.second));
+                }
+                return;
+            }
+            size_t offset = 0;
+            while (offset < packed.size()) {
+                std::string_view field, value;
+                offset = readPair(offset, field, value);
+                fn(field, value);
+            }
+        }
+
+        // One step of an HSCAN walk, see Dict::scan. A packed hash is small
+        // enough to be returned whole, which completes the walk.
+        template <typename Fn>
+        uint64_t scan(uint64_t cursor, size_t count, Fn fn) const {
+            if (!table) {
+                forEach(fn);
+                return 0;
+            }
+            return table->scan(cursor, count, [&fn](const auto& entry) {
+                fn(std::string_view(entry.first), std::string_view(entry.second));
+            });
+        }
+
+        StringMap<std::string> toMap() const;
+
+        // Conversion thresholds, set once at startup from Config
+        static void setLimits(size_t maxEntries, size_t maxValue);
+
+    private:
+        std::string packed;
+        std::unique_ptr<Dict<CompactString, CompactString>> table; // Set once converted
+        union { // One per encoding, sharing a word keeps Object (sized by Hash) smaller
+            size_t count = 0; // Fields in packed
+            size_t tableBytes; // Nodes and strings in table, buckets excluded
+        };
+
+        // Dict node: next pointer, cached hash and the pair
+        static constexpr size_t TABLE_NODE_SIZE = 2 * sizeof(void*) + 2 * sizeof(CompactString);
+
+        static size_t maxPackedEntries;
+        static size_t maxPackedValue;
+
+        size_t readPair(size_t offset, std::string_view& field, std::string_view& value) const;
+        size_t find(std::string_view field, size_t& valueOffset) const;
+        void convertToTable();
+        static size_t tableEntryMemory(const CompactString& field, const CompactString& value);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef IO_URING_H
+#define IO_URING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+// Minimal io_uring wrapper over the raw syscalls: the submission and
+// completion rings, and one provided-buffer ring for multishot receives.
+// Not thread safe; each event loop owns its own instance.
+class IoUring {
+    public:
+        IoUring() = default;
+        ~IoUring();
+        IoUring(const IoUring&) = delete;
+        IoUring& operator=(const IoUring&) = delete;
+
+        // False if the kernel lacks io_uring or a feature used here
+        bool init(unsigned int entries);
+
+        // Next free submission entry, zeroed. Submits what is queued first if the ring is full.
+        io_uring_sqe* getSqe();
+
+        // Submits queued entries and waits up to `timeout` for at least one completion
+        int submitAndWait(std::chrono::milliseconds timeout);
+
+        // Calls fn(const io_uring_cqe&) for every available completion
+        template <typename F>
+        unsigned int forEachCompletion(F&& fn) {
+            unsigned int head = *cqHead;
+            unsigned int tail = std::atomic_ref<unsigned int>(*cqTail).load(std::memory_order_acquire);
+            unsigned int seen = 0;
+            for (; head != tail; head++, seen++) {
+                fn(cqes[head & cqMask]);
+            }
+            std::atomic_ref<unsigned int>(*cqHead).store(head, std::memory_order_release);
+            return seen;
+        }
+
+        // Registers `count` (a power of two) buffers of `size` bytes as buffer group `groupId`
+        bool setupBufferRing(uint16_t groupId, unsigned int count, unsigned int size);
+        const char* buffer(uint16_t bufferId) const { return bufferPool + static_cast<size_t>(bufferId) * bufferSize; }
+        void recycleBuffer(uint16_t bufferId); // Hands a buffer back to the kernel
+
+    private:
+        int ringFd = -1;
+
+        void* sqRingPtr = nullptr;
+        size_t sqRingSize = 0;
+        void* cqRingPtr = nullptr; // Same mapping as sqRingPtr with IORING_FEAT_SINGLE_MMAP
+        size_t cqRingSize = 0;
+        io_uring_sqe* sqes = nullptr;
+        size_t sqesSize = 0;
+
+        unsigned int* sqHead = nullptr;
+        unsigned int* sqTail = nullptr;
+        unsigned int* sqArray = nullptr;
+        unsigned int sqMask = 0;
+        unsigned int sqEntries = 0;
+        unsigned int sqLocalTail = 0; // Entries handed out, published on submit
+        unsigned int toSubmit = 0;
+
+        unsigned int* cqHead = nullptr;
+        unsigned int* cqTail = nullptr;
+        io_uring_cqe* cqes = nullptr;
+        unsigned int cqMask = 0;
+
+        io_uring_buf_ring* bufferRing = nullptr;
+        size_t bufferRingSize = 0;
+        unsigned int bufferCount = 0;
+        char* bufferPool = nullptr;
+        size_t bufferSize = 0;
+
+        void publishSubmissions();
+        int enter(unsigned int submit, unsigned int waitNr, unsigned int flags, const void* arg, size_t argSize);
+};
+
+#endif
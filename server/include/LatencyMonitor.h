@@ -0,0 +1,64 @@
+#ifndef LATENCY_MONITOR_H
+#define LATENCY_MONITOR_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Records internal events (expiry cycles, the fork lock hold, long event
+// loop iterations, slow commands) that took at least the threshold, for the
+// LATENCY command. Each event keeps its last HISTORY_LENGTH samples at one
+// per second, the worst of that second. A zero threshold turns it off, and
+// events under the threshold cost one clock read and a comparison.
+class LatencyMonitor {
+    public:
+        static constexpr size_t HISTORY_LENGTH = 160;
+
+        struct Sample {
+            std::time_t time; // Unix seconds
+            uint64_t millis;
+        };
+
+        struct EventSummary {
+            std::string name;
+            Sample latest;
+            uint64_t maxMillis; // Worst since the last reset
+        };
+
+        static LatencyMonitor& getInstance();
+
+        void setThreshold(std::chrono::milliseconds threshold);
+
+        // Records event as having run from start until now, if that was long enough
+        void record(std::string_view event, std::chrono::steady_clock::time_point start);
+
+        std::vector<EventSummary> latest();
+        std::vector<Sample> history(std::string_view event); // Oldest first
+        size_t reset(const std::vector<std::string_view>& events); // Every event when empty; returns how many were dropped
+
+    private:
+        LatencyMonitor() = default;
+        LatencyMonitor(const LatencyMonitor&) = delete;
+        LatencyMonitor& operator=(const LatencyMonitor&) = delete;
+
+        struct EventHistory {
+            std::array<Sample, HISTORY_LENGTH> samples{};
+            size_t next = 0; // Slot the next sample goes to
+            size_t count = 0;
+            uint64_t maxMillis = 0;
+        };
+
+        std::atomic<int64_t> thresholdMillis{0};
+        std::mutex mutex; // Guards events
+        std::map<std::string, EventHistory, std::less<>> events;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+
+enum class LogLevel : uint8_t {Debug = 0, Info = 1, Warning = 2, Error = 3, Off = 4};
+
+// Calls below this level are compiled out entirely. Build with
+// `make LOG_MIN_LEVEL=0` to keep debug logging (per request and per
+// connection messages); it is then still off unless --loglevel debug.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 1
+#endif
+
+// Asynchronous logger. Event loops only format the message and push it onto
+// a bounded lock-free ring; a background thread drains the ring and writes
+// whole batches, so no request waits on the terminal. When the ring is full
+// messages are dropped and counted rather than blocking the caller. Before
+// start() and after stop() messages are written directly.
+class Logger {
+    private:
+        Logger() = default;
+        ~Logger();
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+        static constexpr size_t RING_SIZE = 4096; // Power of two
+        static constexpr std::chrono::milliseconds DRAIN_INTERVAL{10}; // Sleep when the ring is empty
+
+        // Bounded multi-producer queue (Vyukov): a slot is free for the producer
+        // at position p when sequence == p, and ready for the consumer when
+        // sequence == p + 1
+        struct Slot {
+            std::atomic<uint64_t> sequence;
+            LogLevel level;
+            std::chrono::system_clock::time_point time;
+            std::string message;
+        };
+
+        std::array<Slot, RING_SIZE> ring;
+        alignas(64) std::atomic<uint64_t> enqueuePos{0};
+        alignas(64) uint64_t dequeuePos = 0; // Drain thread only
+        std::atomic<uint64_t> dropped{0};
+
+        std::atomic<LogLevel> minLevel{LogLevel::Info};
+        std::atomic<bool> async{false};
+        std::atomic<bool> stopping{false};
+        std::thread drainThread;
+
+        bool push(LogLevel level, std::string& message);
+        size_t drain(); // Writes out what is queued, returns the messages written
+        void drainLoop();
+        static void format(std::string& out, LogLevel level, std::chrono::system_clock::time_point time, const std::string& message);
+        static void writeOut(LogLevel level, const std::string& text);
+
+    public:
+        static Logger& getInstance();
+
+        void setLevel(LogLevel level) { minLevel.store(level, std::memory_order_relaxed); }
+        bool enabled(LogLevel level) const { return level >= minLevel.load(std::memory_order_relaxed); }
+
+        void start(); // Starts the drain thread
+        void stop(); // Drains what is left and joins the thread
+        void forked(); // Call in a fork child: silences logging there
+
+        void write(LogLevel level, std::string message);
+
+        static bool parseLevel(const std::string& name, LogLevel& level);
+};
+
+// Usage: LOG_INFO("Loaded " << count << " keys"). The message is only
+// formatted when the level is enabled.
+#define LOG_AT(level, expr) \
+    do { \
+        if (Logger::getInstance().enabled(level)) { \
+            std::ostringstream logStream_; \
+            logStream_ << expr; \
+            Logger::getInstance().write(level, std::move(logStream_).str()); \
+        } \
+    } while (0)
+
+#if LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(expr) LOG_AT(LogLevel::Debug, expr)
+#else
+#define LOG_DEBUG(expr) do {} while (0)
+#endif
+#define LOG_INFO(expr) LOG_AT(LogLevel::Info, expr)
+#define LOG_WARNING(expr) LOG_AT(LogLevel::Warning, expr)
+#define LOG_ERROR(expr) LOG_AT(LogLevel::Error, expr)
+
+#endif
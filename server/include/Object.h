@@ -0,0 +1,63 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <variant>
+
+#include "CompactString.h"
+#include "QuickList.h"
+#include "Hash.h"
+
+// Order matches the alternatives of Object::value
+enum class ObjectType : uint8_t {
+    String = 0,
+    List = 1,
+    Hash = 2,
+};
+
+// Everything stored under a key: the typed value plus the per-key metadata
+// (TTL, access tracking) that used to live in side maps keyed by the same string.
+struct Object {
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr Clock::time_point NO_EXPIRY = Clock::time_point::max();
+    static constexpr uint32_t NOT_IN_HEAP = UINT32_MAX;
+    static constexpr uint8_t LFU_INIT = 5; // New keys start above 0 so they are not evicted first
+    static constexpr uint32_t LFU_DECAY_MILLIS = 60 * 1000; // Idle time that takes one off the counter
+    static constexpr uint32_t LRU_NEVER = 0; // lruClock before the first access; currentLruClock() skips it
+
+    std::variant<CompactString, QuickList, Hash> value;
+
+    Clock::time_point expiresAt = NO_EXPIRY;
+    uint32_t heapIndex = NOT_IN_HEAP; // Slot in the shard's expiry heap
+
+    uint32_t lruClock = LRU_NEVER; // currentLruClock() at the last access
+    uint8_t lfuCounter = LFU_INIT; // Logarithmic access counter
+
+    Object() = default;
+    explicit Object(std::string_view string) : value(std::in_place_type<CompactString>, string) { touch(); }
+
+    ObjectType type() const { return static_cast<ObjectType>(value.index()); }
+    bool hasExpiry() const { return expiresAt != NO_EXPIRY; }
+
+    // Records an access for LRU/LFU
+    void touch();
+
+    // Milliseconds since the last access, capped at INT32_MAX (about 24.8
+    // days). The clock wraps every 49.7 days, so `now` must be taken after
+    // the last access, e.g. under the lock of the object's shard.
+    uint32_t idleTime(uint32_t now) const;
+
+    // The LFU counter less one per LFU_DECAY_MILLIS idle, so keys that were
+    // hot once do not stay ahead of the current ones forever
+    uint8_t lfuDecayed(uint32_t now) const;
+
+    // Approximate bytes held, this struct included. O(1) for every type.
+    size_t memoryUsage() const;
+};
+
+uint32_t currentLruClock(); // Milliseconds, wrapping, never LRU_NEVER
+
+#endif
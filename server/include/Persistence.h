@@ -0,0 +1,67 @@
+#ifndef PERSISTENCE_H
+#define PERSISTENCE_H
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// Save after `seconds` if at least `changes` writes happened since the last save
+struct SaveRule {
+    unsigned int seconds;
+    unsigned long long changes;
+};
+
+// Background snapshots. A save forks a child that writes the dataset as of
+// the fork (copy-on-write pages keep it frozen) while the server keeps
+// serving; the event loop reaps the child and checks the save rules through
+// cron(), so nothing is written while the dataset is unchanged.
+class Persistence {
+    private:
+        Persistence() = default;
+        Persistence(const Persistence&) = delete;
+        Persistence& operator=(const Persistence&) = delete;
+
+        static constexpr std::time_t RETRY_DELAY = 5; // Seconds between attempts after a failed save
+
+        std::mutex mutex;
+        std::string filename = "dump";
+        std::vector<SaveRule> saveRules;
+
+        pid_t childPid = -1;
+        std::chrono::steady_clock::time_point childStart;
+        uint64_t childDirty = 0; // Database::dirtyCount() when the child forked
+
+        std::time_t lastSave = std::time(nullptr);
+        std::time_t lastAttempt = 0;
+        uint64_t lastSaveDirty = 0;
+        bool lastSaveOk = true;
+
+        bool startSave(); // Caller holds mutex
+
+    public:
+        static Persistence& getInstance();
+
+        // Sets the snapshot file and save rules, and treats the dataset loaded
+        // at startup as saved
+        void configure(const std::string& filename, const std::vector<SaveRule>& rules);
+
+        // Starts a background save; false if one is already running or fork failed
+        bool backgroundSave();
+
+        // Reaps a finished child without blocking, then applies the save rules
+        void cron();
+
+        // Stops a running child before the final foreground save
+        void shutdown();
+
+        bool saveInProgress();
+        std::time_t lastSaveTime();
+        bool lastSaveSucceeded();
+        uint64_t changesSinceLastSave();
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef QUICK_LIST_H
+#define QUICK_LIST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// List encoding used by Database: a doubly linked list of nodes, each holding
+// up to NODE_MAX_BYTES of packed entries in one contiguous buffer. Pushing and
+// popping at either end touches one node, so both are O(1) regardless of the
+// list length, and an element costs its length plus 2-3 bytes of framing
+// instead of a heap-allocated std::string.
+//
+// Entry layout inside a node:  [varint len][bytes][backlen]
+// backlen is the size of "[varint len][bytes]" written so that it can be
+// read from its last byte backwards, which makes reverse walks (RPOP, LREM
+// with a negative count) as cheap as forward ones.
+class QuickList {
+    public:
+        QuickList() = default;
+        ~QuickList();
+
+        QuickList(const QuickList& other);
+        QuickList& operator=(const QuickList& other);
+        QuickList(QuickList&& other) noexcept;
+        QuickList& operator=(QuickList&& other) noexcept;
+
+        size_t size() const { return length; }
+        bool empty() const { return length == 0; }
+        size_t memoryUsage() const { return bytes; } // Heap bytes held by the nodes
+
+        void pushFront(std::string_view value);
+        void pushBack(std::string_view value);
+        bool popFront(std::string& value);
+        bool popBack(std::string& value);
+
+        // Negative indexes count from the tail
+        bool index(long long index, std::string& value) const;
+        bool set(long long index, std::string_view value);
+
+        // LREM semantics: count > 0 removes from the head, < 0 from the tail, 0 removes all
+        size_t remove(long long count, std::string_view value);
+
+        void clear();
+
+        // Calls fn(std::string_view) for every element, head to tail
+        template <typename Fn>
+        void forEach(Fn fn) const {
+            for (const Node* node = head; node != nullptr; node = node->next) {
+                size_t offset = 0;
+                while (offset < node->data.size()) {
+                    std::string_view entry;
+                    offset = readEntry(node->data, offset, entry);
+                    fn(entry);
+                }
+            }
+        }
+
+        std::vector<std::string> toVector() const;
+
+        static constexpr size_t NODE_MAX_BYTES = 8 * 1024;
+
+    private:
+        struct Node {
+            Node* prev = nullptr;
+            Node* next = nullptr;
+            std::string data; // Packed entries
+            uint32_t count = 0;
+        };
+
+        Node* head = nullptr;
+        Node* tail = nullptr;
+        size_t length = 0;
+        size_t bytes = 0; // Node structs plus the capacity of their buffers
+
+        static void encodeEntry(char* out, std::string_view value);
+        static size_t entrySize(std::string_view value);
+        static size_t readEntry(const std::string& data, size_t offset, std::string_view& value);
+        static size_t entryStartBefore(const std::string& data, size_t end);
+
+        Node* insertNode(Node* before, Node* after);
+        void unlinkNode(Node* node);
+        void resizeData(Node* node, size_t oldCapacity); // Accounts for a change to node->data
+        Node* locate(long long index, size_t& offset) const;
+};
+
+#endif
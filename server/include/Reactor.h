@@ -0,0 +1,78 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../include/CommandHandler.h"
+#include "../include/RespParser.h"
+
+enum class IoBackend {Epoll, IoUring};
+
+// One event loop. Every reactor owns its own listening socket (bound with
+// SO_REUSEPORT so the kernel spreads new connections across reactors), the
+// clients it accepted, and runs on its own thread. Nothing here is shared
+// between reactors; the only shared state is Database.
+//
+// This class holds the part every I/O backend shares: turning received bytes
+// into commands and replies, and the periodic housekeeping. The backends
+// (EpollReactor, UringReactor) move the bytes.
+class Reactor {
+    protected:
+        int id;
+        int port;
+        std::atomic<bool>& running;
+        const unsigned int MAX_CLIENTS = 32; // Maximum number of clients per reactor
+        const int EPOLL_TIMEOUT_MS = 100; // Wake up periodically to notice shutdown and run cron
+        const std::chrono::milliseconds CRON_INTERVAL{100}; // Background housekeeping period
+        const std::chrono::microseconds ACTIVE_EXPIRE_BUDGET{1000}; // Time spent expiring keys per cron run
+        const std::chrono::microseconds REHASH_BUDGET{1000}; // Time spent on keyspace resizes per cron run
+        const size_t READ_COMPACT_THRESHOLD = 16 * 1024; // Consumed bytes before the read buffer is compacted
+
+        struct Client {
+            int socket = -1;
+            std::string readBuffer;
+            size_t readPos = 0; // Start of the unparsed data in readBuffer
+            RespParser parser; // Keeps its place in a partially received command
+            std::string writeBuffer; // Replies not yet handed to the socket
+            bool queued = false; // Waiting in the backend's list of clients to write
+            bool closeAfterWrite = false; // Protocol error: send what is queued, then close
+            bool awaitingSync = false; // Has replies to commands logged since the last flush
+        };
+
+        CommandHandler commandHandler;
+        std::vector<std::string_view> parsedCommand; // Reused for every command
+        std::chrono::steady_clock::time_point nextCron;
+
+        Reactor(int id, int port, std::atomic<bool>& running);
+
+        int openListenSocket(); // Non-blocking, SO_REUSEPORT; -1 on failure
+        void runCronIfDue();
+        void cron();
+
+        // Runs every complete command in the read buffer and queues the
+        // replies. Returns false on a protocol error, after queueing the error
+        // reply and marking the client closeAfterWrite.
+        bool processInput(Client& client);
+        void compactReadBuffer(Client& client);
+
+        // Replies pile up while a batch of events is processed and go out in
+        // one send per client at the end of it
+        virtual void queueWrite(Client& client) = 0;
+
+    public:
+        virtual ~Reactor() = default;
+
+        Reactor(const Reactor&) = delete;
+        Reactor& operator=(const Reactor&) = delete;
+
+        static std::unique_ptr<Reactor> create(IoBackend backend, int id, int port, std::atomic<bool>& running);
+
+        virtual bool setup() = 0;
+        virtual void run() = 0;
+};
+
+#endif
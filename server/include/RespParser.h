@@ -0,0 +1,54 @@
+#ifndef RESP_PARSER_H
+#define RESP_PARSER_H
+
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+// Incremental RESP parser. One instance lives in every client and remembers
+// how far it got in the command currently being received: the header lines
+// already scanned, the array elements still expected and the bulk string
+// bytes still missing. Feeding it more data resumes from that point instead
+// of re-parsing the command from the start, so a value that arrives over
+// many recv calls is parsed in linear time.
+//
+// The buffer passed to parse() must always start at the first byte of the
+// command being parsed; the caller may append to it (or move it) between
+// calls. Tokens are views into that buffer.
+class RespParser {
+    public:
+        enum class Result {
+            Incomplete, // Need more data, state is kept
+            Complete,   // tokens and parsedLen are set, state is reset
+            Error       // Protocol error, the connection should be dropped
+        };
+
+        Result parse(std::string_view buffer, std::vector<std::string_view>& tokens, size_t& parsedLen);
+
+        // Bytes still required to finish the bulk string being received (0 if unknown)
+        size_t bytesNeeded() const { return needed; }
+
+        void reset();
+
+        static constexpr long long MAX_BULK_LENGTH = 512LL * 1024 * 1024;
+        static constexpr long long MAX_ARRAY_LENGTH = 1024 * 1024;
+
+    private:
+        size_t pos = 0;      // Offset (from the command start) where parsing resumes
+        size_t scanPos = 0;  // Where the search for the next CRLF resumes
+        long long bulkLength = -1; // Length of the bulk string whose payload is pending, -1 if none
+        size_t needed = 0;
+        bool started = false;
+
+        std::vector<long long> pendingElements; // Elements left at each open array level
+        std::vector<std::pair<size_t, size_t>> tokenOffsets; // (offset, length) of every token so far
+
+        bool readLine(std::string_view buffer, std::string_view& line);
+        bool elementDone();
+};
+
+// Returns the offset of the first "\r\n" at or after `from`, or npos
+size_t findCRLF(std::string_view buffer, size_t from);
+
+#endif
@@ -2,34 +2,27 @@
 #define SERVER_HPP
 
 #include <atomic>
-#include <unordered_map>
-#include <string>
+#include <memory>
+#include <vector>
+#include "../include/Reactor.h"
 
 class Server {
     private:
         int port;
-        int serverSocket;
+        unsigned int numThreads; // Number of event-loop threads
+        IoBackend backend;
         std::atomic<bool> running;
-        const unsigned int MAX_CLIENTS = 32; // Maximum number of clients to handle
-        const int BUFFER_SIZE = 4096; // Size of the buffer for reading data
-        
-        struct Client {
-            int socket;
-            std::string readBuffer;
-            std::string writeBuffer;
-            bool hasPendingWrite = false;
-        };
 
-        std::unordered_map<int, Client> clients;
+        std::vector<std::unique_ptr<Reactor>> reactors;
 
     public:
-        Server(int port);
+        Server(int port, unsigned int numThreads, IoBackend backend = IoBackend::Epoll);
         ~Server() = default;  
         
         void shutdown();
-        void run();
+        bool run(); // False if the event loops could not be started
 
         void setupSignalHandler();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,53 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <cstddef>
+#include <new>
+
+// Size-class allocator for the small blocks the store holds millions of:
+// key and value strings, and keyspace nodes. Blocks are carved out of 64KB
+// pages in 8-byte steps, so a block costs its size rounded up to 8 with no
+// per-block header, and blocks of one size share pages instead of being
+// scattered across the heap. Pages are kept for reuse, never handed back.
+//
+// Each thread keeps a short free list per size class and only takes the
+// class lock to move a batch of blocks between it and the shared list.
+class Slab {
+    public:
+        static constexpr size_t GRANULARITY = 8;
+        static constexpr size_t MAX_SIZE = 256; // Larger blocks go to operator new
+
+        static void* allocate(size_t size);
+        static void deallocate(void* block, size_t size); // size as passed to allocate
+
+        // What a block of `size` bytes really takes
+        static constexpr size_t allocationSize(size_t size) {
+            return size > MAX_SIZE ? size : (size + GRANULARITY - 1) / GRANULARITY * GRANULARITY;
+        }
+
+        static size_t pageBytes(); // Memory held in slab pages, in use or free
+};
+
+// Standard allocator over Slab, for node-based containers
+template <typename T>
+struct SlabAllocator {
+    using value_type = T;
+
+    static_assert(alignof(T) <= Slab::GRANULARITY, "Slab blocks are only 8-byte aligned");
+
+    SlabAllocator() = default;
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(Slab::allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) {
+        Slab::deallocate(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U>&) const { return true; }
+};
+
+#endif
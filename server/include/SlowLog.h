@@ -0,0 +1,56 @@
+#ifndef SLOW_LOG_H
+#define SLOW_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The last maxLength commands that took logSlowerThan microseconds or more,
+// newest first, for SLOWLOG. Only the threshold check is on the hot path;
+// the lock is taken once a command turns out to be slow.
+class SlowLog {
+    public:
+        static constexpr size_t MAX_ARGS = 32; // Arguments kept per entry, the last one says how many were dropped
+        static constexpr size_t MAX_ARG_LENGTH = 128; // Bytes kept per argument
+
+        struct Entry {
+            uint64_t id;
+            std::time_t time; // Unix seconds when the command finished
+            uint64_t micros;
+            std::vector<std::string> args;
+        };
+
+        static SlowLog& getInstance();
+
+        // threshold in microseconds: 0 logs every command, negative disables
+        void configure(long long threshold, size_t maxLength);
+
+        bool isSlow(uint64_t micros) const {
+            long long threshold = logSlowerThan.load(std::memory_order_relaxed);
+            return threshold >= 0 && micros >= static_cast<uint64_t>(threshold);
+        }
+
+        void add(const std::vector<std::string_view>& args, uint64_t micros);
+        std::vector<Entry> get(size_t count); // Newest first
+        size_t length();
+        void reset();
+
+    private:
+        SlowLog() = default;
+        SlowLog(const SlowLog&) = delete;
+        SlowLog& operator=(const SlowLog&) = delete;
+
+        std::atomic<long long> logSlowerThan{10000};
+        std::mutex mutex; // Guards everything below
+        size_t maxLength = 128;
+        uint64_t nextId = 0;
+        std::deque<Entry> entries; // Newest at the front
+};
+
+#endif
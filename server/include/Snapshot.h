@@ -0,0 +1,127 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/types.h>
+
+// Binary snapshot format (all integers little endian):
+//
+//   "SHAUNSDB" version:u8 sectionCount:u32
+//   section table: sectionCount x (offset:u64 length:u64 keys:u64 crc32:u32)
+//   crc32:u32                      crc32 of every byte before it
+//   sections...                    records, back to back
+//
+// Each section is checksummed on its own and holds a known number of keys,
+// so the loader can verify and decode sections on separate threads and size
+// the tables up front. Version 1 files (records, then 0xFF and a crc32 over
+// the whole file) are still read, on a single thread.
+//
+// A record is
+//   type:u8 flags:u8 [expiresAt:u64 if flags & SNAPSHOT_HAS_EXPIRY] key payload
+// where strings are varint length + bytes, and the payload is a string, a
+// list (varint count + strings) or a hash (varint count + field/value
+// strings), depending on type (the ObjectType value). expiresAt is an
+// absolute Unix time in milliseconds, so TTLs survive a restart.
+
+static constexpr char SNAPSHOT_MAGIC[8] = {'S', 'H', 'A', 'U', 'N', 'S', 'D', 'B'};
+static constexpr uint8_t SNAPSHOT_VERSION = 2;
+static constexpr uint8_t SNAPSHOT_VERSION_SINGLE = 1; // Unsectioned format, read only
+static constexpr uint8_t SNAPSHOT_EOF = 0xFF; // Ends a version 1 file
+static constexpr uint8_t SNAPSHOT_HAS_EXPIRY = 1;
+
+uint32_t crc32(uint32_t crc, const char* data, size_t len);
+
+struct SnapshotSection {
+    uint64_t offset = 0; // From the start of the file
+    uint64_t length = 0;
+    uint64_t keys = 0;
+    uint32_t crc = 0;
+};
+
+// Buffers writes in large chunks and checksums each section as it goes.
+// Output goes to a temp file next to the target, which finish() fsyncs and
+// renames over it, so a crash mid-write leaves the previous snapshot intact.
+class SnapshotWriter {
+    public:
+        SnapshotWriter(const std::string& filename, uint32_t sectionCount);
+        ~SnapshotWriter();
+        SnapshotWriter(const SnapshotWriter&) = delete;
+        SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+        bool isOpen() const { return fd >= 0; }
+
+        void writeByte(uint8_t value) { buffer.push_back(static_cast<char>(value)); maybeFlush(); }
+        void writeFixed64(uint64_t value);
+        void writeVarint(uint64_t value);
+        void writeString(std::string_view value);
+
+        // Records go between beginSection and endSection, sections in table order
+        void beginSection();
+        void endSection(uint64_t keys);
+
+        // Fills in the section table, syncs and renames into place; false if any step failed
+        bool finish();
+
+        // Temp file used by the writer in process pid
+        static std::string tempFilenameFor(const std::string& filename, pid_t pid);
+
+    private:
+        static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+        std::string filename;
+        std::string tempFilename;
+        int fd = -1;
+        bool failed = false;
+        std::string buffer;
+        uint64_t offset = 0; // Bytes handed to write() so far
+        uint32_t crc = 0; // Of the current section
+        std::vector<SnapshotSection> sections;
+        size_t headerSize;
+
+        void maybeFlush() { if (buffer.size() >= BUFFER_SIZE) flush(); }
+        void flush();
+        void writeAll(const char* data, size_t len);
+};
+
+// Decodes a snapshot mapped into memory. Every read is bounds checked and
+// returns false on truncated input. section() hands out readers over one
+// section of the mapping, which can be used from other threads.
+class SnapshotReader {
+    public:
+        SnapshotReader() = default;
+        ~SnapshotReader();
+        SnapshotReader(const SnapshotReader&) = delete;
+        SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+        bool open(const std::string& filename);
+        bool hasMagic() const;
+        bool readHeader(uint8_t& version); // Consumes the magic and version
+        // Version 1: checks the trailing checksum and excludes it from the readable range
+        bool verifyChecksum();
+
+        // Version 2: reads and checks the section table that follows the version
+        bool readSections(std::vector<SnapshotSection>& sections);
+        bool verifySection(const SnapshotSection& section) const;
+        SnapshotReader section(const SnapshotSection& section) const; // Valid while this reader is
+
+        bool readByte(uint8_t& value);
+        bool readFixed64(uint64_t& value);
+        bool readVarint(uint64_t& value);
+        bool readString(std::string_view& value); // View into the mapping
+
+        size_t remaining() const { return end - pos; }
+
+    private:
+        SnapshotReader(const char* begin, const char* end) : pos(begin), end(end) {}
+
+        const char* base = nullptr; // Null for a section view, which owns no mapping
+        size_t mappedSize = 0;
+        const char* pos = nullptr;
+        const char* end = nullptr;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Latency distribution in microseconds, HDR style: values below 16 get a
+// bucket each, above that every power of two is split into 16 buckets, so
+// any value is off by at most 1/16 whatever its magnitude. Values from
+// 2^40 us (about 12 days) up share the last bucket.
+class LatencyHistogram {
+    public:
+        static constexpr unsigned SUB_BUCKET_BITS = 4;
+        static constexpr uint64_t SUB_BUCKETS = uint64_t(1) << SUB_BUCKET_BITS;
+        static constexpr unsigned MAX_MAGNITUDE = 40;
+        static constexpr size_t BUCKETS = (MAX_MAGNITUDE - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        static size_t bucketFor(uint64_t micros);
+        static uint64_t bucketLimit(size_t bucket); // Highest value the bucket holds
+
+        void add(size_t bucket, uint64_t calls) { counts[bucket] += calls; total += calls; }
+        void record(uint64_t micros) { add(bucketFor(micros), 1); }
+        void merge(const LatencyHistogram& other);
+        uint64_t count() const { return total; }
+
+        // Upper bound of the bucket holding the given fraction (0 to 1) of
+        // the values, 0 when empty
+        uint64_t percentile(double fraction) const;
+
+    private:
+        std::array<uint64_t, BUCKETS> counts{};
+        uint64_t total = 0;
+};
+
+// Server-wide counters for INFO. Commands are recorded on the hot path into
+// counters owned by the calling thread, plain loads and stores with no lock
+// or read-modify-write, and only added up when they are read. Each thread's
+// counters outlive it, so nothing is lost when a thread exits.
+class Stats {
+    public:
+        static constexpr size_t MAX_COMMANDS = 64; // Slots per thread, indexed by CommandHandler's table
+
+        // One command's totals across all threads
+        struct CommandSummary {
+            uint64_t calls = 0;
+            uint64_t micros = 0;
+            LatencyHistogram latency;
+        };
+
+        static Stats& getInstance();
+
+        void recordCommand(size_t command, uint64_t micros);
+        std::vector<CommandSummary> commandSummaries(); // MAX_COMMANDS entries
+
+        void clientConnected();
+        void clientDisconnected();
+        void connectionRejected();
+        uint64_t connectedClients() const { return connected.load(std::memory_order_relaxed); }
+        uint64_t totalConnections() const { return connections.load(std::memory_order_relaxed); }
+        uint64_t rejectedConnections() const { return rejected.load(std::memory_order_relaxed); }
+
+        // What the server ended up running with, set once the event loops are up
+        void setServerInfo(int port, unsigned int eventLoops, const std::string& ioBackend);
+        int getPort() const { return port; }
+        unsigned int getEventLoops() const { return eventLoops; }
+        const std::string& getIoBackend() const { return ioBackend; }
+        uint64_t uptimeSeconds() const;
+
+    private:
+        Stats() = default;
+        Stats(const Stats&) = delete;
+        Stats& operator=(const Stats&) = delete;
+
+        struct CommandCounters {
+            std::atomic<uint64_t> calls{0};
+            std::atomic<uint64_t> micros{0};
+            std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKETS> latency{};
+        };
+
+        struct ThreadCounters {
+            std::array<CommandCounters, MAX_COMMANDS> commands;
+        };
+
+        std::mutex mutex; // Guards threads
+        std::vector<std::unique_ptr<ThreadCounters>> threads;
+
+        std::atomic<uint64_t> connected{0};
+        std::atomic<uint64_t> connections{0};
+        std::atomic<uint64_t> rejected{0};
+
+        std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+        int port = 0;
+        unsigned int eventLoops = 0;
+        std::string ioBackend;
+
+        ThreadCounters& localCounters();
+};
+
+#endif
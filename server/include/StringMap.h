@@ -0,0 +1,99 @@
+#ifndef STRING_MAP_H
+#define STRING_MAP_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Transparent hashing so the maps can be searched with a std::string_view
+// straight out of the client read buffer, without building a std::string.
+// The hash follows wyhash: a few multiplies per 16 bytes and good mixing in
+// every bit, which Dict needs since it takes the low bits for the bucket and
+// Database the high ones for the shard. The seed is drawn at startup, so
+// clients cannot pick keys that all collide.
+struct StringHash {
+    public:
+        using is_transparent = void;
+
+        size_t operator()(std::string_view value) const {
+            constexpr uint64_t P0 = 0xa0761d6478bd642full, P1 = 0xe7037ed1a0b428dbull;
+            constexpr uint64_t P2 = 0x8ebc6af09c88c6e3ull, P3 = 0x589965cc75374cc3ull;
+            const char* p = value.data();
+            size_t len = value.size();
+            uint64_t state = seed ^ mix(seed ^ P0, P1);
+            uint64_t a = 0, b = 0;
+
+            if (len <= 16) {
+                if (len >= 4) {
+                    size_t middle = (len >> 3) << 2;
+                    a = (read32(p) << 32) | read32(p + middle);
+                    b = (read32(p + len - 4) << 32) | read32(p + len - 4 - middle);
+                } else if (len > 0) {
+                    a = (uint64_t(uint8_t(p[0])) << 16) | (uint64_t(uint8_t(p[len >> 1])) << 8) | uint8_t(p[len - 1]);
+                }
+            } else {
+                size_t remaining = len;
+                if (remaining > 48) {
+                    uint64_t state1 = state, state2 = state;
+                    do {
+                        state = mix(read64(p) ^ P1, read64(p + 8) ^ state);
+                        state1 = mix(read64(p + 16) ^ P2, read64(p + 24) ^ state1);
+                        state2 = mix(read64(p + 32) ^ P3, read64(p + 40) ^ state2);
+                        p += 48;
+                        remaining -= 48;
+                    } while (remaining > 48);
+                    state ^= state1 ^ state2;
+                }
+                while (remaining > 16) {
+                    state = mix(read64(p) ^ P1, read64(p + 8) ^ state);
+                    p += 16;
+                    remaining -= 16;
+                }
+                a = read64(p + remaining - 16); // The last 16 bytes, overlapping what came before
+                b = read64(p + remaining - 8);
+            }
+
+            __uint128_t product = static_cast<__uint128_t>(a ^ P1) * (b ^ state);
+            return mix(static_cast<uint64_t>(product) ^ P0 ^ len, static_cast<uint64_t>(product >> 64) ^ P1);
+        }
+
+    private:
+        static uint64_t mix(uint64_t a, uint64_t b) {
+            __uint128_t product = static_cast<__uint128_t>(a) * b;
+            return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+        }
+
+        static uint64_t read64(const char* p) {
+            uint64_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        static uint64_t read32(const char* p) {
+            uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        static uint64_t randomSeed() {
+            std::random_device device;
+            return (static_cast<uint64_t>(device()) << 32) | device();
+        }
+
+        static inline const uint64_t seed = randomSeed();
+};
+
+template <typename Value>
+using StringMap = std::unordered_map<std::string, Value, StringHash, std::equal_to<>>;
+
+// Heap bytes behind a string, 0 while it fits the inline buffer
+inline size_t stringMemory(const std::string& value) {
+    static const size_t inlineCapacity = std::string().capacity();
+    return value.capacity() > inlineCapacity ? value.capacity() + 1 : 0;
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef URING_REACTOR_H
+#define URING_REACTOR_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "../include/Reactor.h"
+#include "../include/IoUring.h"
+
+// io_uring backend (Linux 6.0+): one multishot accept, one multishot recv per
+// client filling buffers from a provided-buffer ring, and the sends of a
+// whole batch submitted together with the next wait, so a busy loop makes
+// one io_uring_enter per iteration instead of a syscall per operation.
+class UringReactor : public Reactor {
+    private:
+        static constexpr unsigned int RING_ENTRIES = 1024;
+        static constexpr uint16_t BUFFER_GROUP = 0;
+        static constexpr unsigned int RECV_BUFFER_COUNT = 256; // Power of two
+        static constexpr unsigned int RECV_BUFFER_SIZE = 16 * 1024;
+
+        // user_data: operation in the top byte, client id below
+        enum Operation : uint64_t {Accept = 1, Recv = 2, Send = 3};
+        static constexpr int OPERATION_SHIFT = 56;
+
+        // Clients are keyed by a counter rather than the fd, so a completion
+        // that arrives after a close cannot be taken for a new connection on a reused fd
+        struct UringClient : Client {
+            uint64_t id = 0;
+            std::string sendBuffer; // Owned by the kernel while a send is in flight
+            size_t sendPos = 0;
+            bool receiving = false; // Multishot recv armed
+            bool sending = false;
+            bool closing = false; // Shut down, waiting for its operations to finish
+        };
+
+        int serverSocket = -1;
+        bool accepting = false;
+        std::unordered_map<uint64_t, UringClient> clients;
+        uint64_t nextClientId = 1;
+        std::vector<uint64_t> pendingWrites; // Clients with replies to send
+        IoUring ring; // Last, so it is torn down before the buffers its operations point into
+
+        void armAccept();
+        void armRecv(UringClient& client);
+        void submitSend(UringClient& client);
+        void handleCompletion(const io_uring_cqe& cqe);
+        void onAccept(const io_uring_cqe& cqe);
+        void onRecv(UringClient& client, const io_uring_cqe& cqe);
+        void onSend(UringClient& client, const io_uring_cqe& cqe);
+        void queueWrite(Client& client) override;
+        void flushPendingWrites(bool logSynced);
+        void startClose(UringClient& client);
+        void releaseIfDone(uint64_t clientId);
+
+    public:
+        UringReactor(int id, int port, std::atomic<bool>& running);
+        ~UringReactor() override;
+
+        // Runs a multishot accept and a multishot recv into a buffer ring over
+        // loopback, once at startup: every feature the reactor relies on, so a
+        // kernel that has io_uring but lacks one of them is caught up front
+        static bool probe();
+
+        bool setup() override;
+        void run() override;
+};
+
+#endif
@@ -0,0 +1,494 @@
+#include "../include/Database.h"
+#include "../include/CommandHandler.h"
+#include "../include/RespParser.h"
+#include "../include/Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// In-process microbenchmarks for the hot paths: RESP parsing, command
+// dispatch, Database operations at several collection sizes and snapshot
+// dump/load. Every case is calibrated to a minimum time per sample, warmed
+// up, then sampled repeatedly; the median and the median absolute deviation
+// are reported, so one noisy sample does not move the result. Compare runs
+// on the same machine with the same build.
+
+struct Options {
+    std::string filter; // Only cases whose name contains this
+    unsigned int repetitions = 10; // Samples kept per case
+    unsigned int warmup = 2; // Samples run and thrown away after calibration
+    std::chrono::milliseconds minTime{20}; // Minimum length of one sample
+    bool csv = false;
+    bool list = false;
+};
+
+// One benchmark. setup runs once before timing and may fill in the per-op
+// counts; body runs the operation `iterations` times.
+struct Case {
+    std::string name;
+    std::function<void(Case&)> setup;
+    std::function<void(uint64_t iterations)> body;
+    uint64_t itemsPerOp = 1; // Commands, keys, ... handled by one op
+    uint64_t bytesPerOp = 0; // 0 if throughput in bytes means nothing here
+};
+
+struct Result {
+    uint64_t iterations = 0; // Per sample
+    double medianNs = 0;     // Per op
+    double minNs = 0;
+    double madPercent = 0;   // Median absolute deviation, relative to the median
+};
+
+// Keeps the compiler from dropping a computation whose result is unused
+template <typename T>
+static void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+static double timeIterations(const Case& benchmark, uint64_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    benchmark.body(iterations);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+static Result measure(const Options& options, const Case& benchmark) {
+    // Grow the iteration count until one sample takes at least minTime;
+    // these runs double as the first warmup
+    double target = std::chrono::duration<double, std::nano>(options.minTime).count();
+    uint64_t iterations = 1;
+    while (true) {
+        double elapsed = timeIterations(benchmark, iterations);
+        if (elapsed >= target) {
+            break;
+        }
+        double scale = elapsed > 0 ? target / elapsed * 1.2 : 10;
+        iterations = static_cast<uint64_t>(iterations * std::clamp(scale, 1.5, 10.0)) + 1;
+    }
+    for (unsigned int i = 0; i < options.warmup; i++) {
+        timeIterations(benchmark, iterations);
+    }
+
+    std::vector<double> samples;
+    for (unsigned int i = 0; i < options.repetitions; i++) {
+        samples.push_back(timeIterations(benchmark, iterations) / iterations);
+    }
+    Result result;
+    result.iterations = iterations;
+    result.medianNs = median(samples);
+    result.minNs = *std::min_element(samples.begin(), samples.end());
+    std::vector<double> deviations;
+    for (double sample : samples) {
+        deviations.push_back(std::abs(sample - result.medianNs));
+    }
+    result.madPercent = result.medianNs > 0 ? median(deviations) / result.medianNs * 100 : 0;
+    return result;
+}
+
+static std::string keyName(const char* prefix, uint64_t n) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%s%012llu", prefix, static_cast<unsigned long long>(n));
+    return buffer;
+}
+
+static std::vector<std::string> makeNames(const char* prefix, uint64_t count) {
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (uint64_t i = 0; i < count; i++) {
+        names.push_back(keyName(prefix, i));
+    }
+    return names;
+}
+
+static void appendCommand(std::string& out, const std::vector<std::string_view>& args) {
+    out += '*';
+    out += std::to_string(args.size());
+    out += "\r\n";
+    for (std::string_view arg : args) {
+        out += '$';
+        out += std::to_string(arg.size());
+        out += "\r\n";
+        out.append(arg);
+        out += "\r\n";
+    }
+}
+
+// State the cases share; rebuilt by each setup that needs it
+struct Fixture {
+    std::vector<std::string> keys;
+    std::vector<std::string> fields;
+    std::string value = std::string(16, 'v');
+    std::string buffer; // Pipelined commands for the parser cases
+    std::string dumpFile;
+    uint64_t next = 0;
+
+    // Cycles through the keys so successive ops touch different buckets
+    const std::string& nextKey() { return keys[next++ % keys.size()]; }
+    const std::string& nextField() { return fields[next++ % fields.size()]; }
+};
+
+static Fixture fixture;
+
+static void fillStrings(uint64_t count) {
+    Database& db = Database::getInstance();
+    db.flushAll();
+    fixture.keys = makeNames("key:", count);
+    for (const std::string& key : fixture.keys) {
+        db.set(key, fixture.value);
+    }
+}
+
+static void fillList(uint64_t length) {
+    Database& db = Database::getInstance();
+    db.flushAll();
+    fixture.keys = {"list"};
+    for (uint64_t i = 0; i < length; i++) {
+        db.rpush("list", fixture.value);
+    }
+}
+
+static void fillHash(uint64_t fields) {
+    Database& db = Database::getInstance();
+    db.flushAll();
+    fixture.keys = {"hash"};
+    fixture.fields = makeNames("field:", fields);
+    for (const std::string& field : fixture.fields) {
+        db.hset({"HSET", "hash", field, fixture.value});
+    }
+}
+
+// Mostly strings, with a list and a hash every ten keys
+static void fillMixed(uint64_t count) {
+    Database& db = Database::getInstance();
+    db.flushAll();
+    fixture.keys = makeNames("key:", count);
+    std::vector<std::string> fields = makeNames("field:", 8);
+    for (uint64_t i = 0; i < count; i++) {
+        const std::string& key = fixture.keys[i];
+        if (i % 10 == 0) {
+            for (int j = 0; j < 8; j++) {
+                db.rpush(key, fixture.value);
+            }
+        } else if (i % 10 == 1) {
+            for (const std::string& field : fields) {
+                db.hset({"HSET", key, field, fixture.value});
+            }
+        } else {
+            db.set(key, fixture.value);
+        }
+    }
+}
+
+static uint64_t fileSize(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+}
+
+static std::vector<Case> buildCases() {
+    std::vector<Case> cases;
+    Database& db = Database::getInstance();
+    static CommandHandler handler;
+
+    // RESP parsing of pipelined SETs, and of one large bulk string
+    for (uint64_t commands : {1, 16, 256, 4096}) {
+        cases.push_back({"resp/pipeline-" + std::to_string(commands), [commands](Case& self) {
+            fixture.buffer.clear();
+            for (uint64_t i = 0; i < commands; i++) {
+                appendCommand(fixture.buffer, {"SET", keyName("key:", i), fixture.value});
+            }
+            self.itemsPerOp = commands;
+            self.bytesPerOp = fixture.buffer.size();
+        }, [](uint64_t iterations) {
+            RespParser parser;
+            std::vector<std::string_view> tokens;
+            for (uint64_t i = 0; i < iterations; i++) {
+                std::string_view pending(fixture.buffer);
+                while (!pending.empty()) {
+                    size_t parsedLen = 0;
+                    if (parser.parse(pending, tokens, parsedLen) != RespParser::Result::Complete) {
+                        std::abort();
+                    }
+                    pending.remove_prefix(parsedLen);
+                }
+                keep(tokens);
+            }
+        }});
+    }
+    cases.push_back({"resp/bulk-64k", [](Case& self) {
+        fixture.buffer.clear();
+        appendCommand(fixture.buffer, {"SET", "key", std::string(64 * 1024, 'v')});
+        self.bytesPerOp = fixture.buffer.size();
+    }, [](uint64_t iterations) {
+        RespParser parser;
+        std::vector<std::string_view> tokens;
+        size_t parsedLen = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            if (parser.parse(fixture.buffer, tokens, parsedLen) != RespParser::Result::Complete) {
+                std::abort();
+            }
+            keep(tokens);
+        }
+    }});
+
+    // Full dispatch through handleCommand: lookup, arity check, handler, stats
+    auto dispatch = [](std::vector<std::string_view> command) {
+        return [command](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                std::string reply = handler.handleCommand(command);
+                keep(reply);
+            }
+        };
+    };
+    auto oneKey = [](Case&) { fillStrings(1); };
+    cases.push_back({"dispatch/ping", oneKey, dispatch({"PING"})});
+    cases.push_back({"dispatch/get", oneKey, dispatch({"GET", "key:000000000000"})});
+    cases.push_back({"dispatch/set", oneKey, dispatch({"SET", "key:000000000000", "value"})});
+    cases.push_back({"dispatch/hset", oneKey, dispatch({"HSET", "hash", "field", "value"})});
+    cases.push_back({"dispatch/unknown", oneKey, dispatch({"NOSUCHCOMMAND", "arg"})});
+
+    // Keyspace operations, cycling over every key of a keyspace of each size
+    for (uint64_t size : {1000, 100000, 1000000}) {
+        std::string suffix = "/" + std::to_string(size);
+        auto fill = [size](Case&) { fillStrings(size); };
+        cases.push_back({"db/set" + suffix, fill, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                db.set(fixture.nextKey(), fixture.value);
+            }
+        }});
+        cases.push_back({"db/get" + suffix, fill, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                std::string value = db.get(fixture.nextKey());
+                keep(value);
+            }
+        }});
+        cases.push_back({"db/exists" + suffix, fill, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                bool found = db.exists(fixture.nextKey());
+                keep(found);
+            }
+        }});
+        cases.push_back({"db/del+set" + suffix, fill, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                const std::string& key = fixture.nextKey();
+                db.del(key);
+                db.set(key, fixture.value);
+            }
+        }});
+        cases.push_back({"db/expire" + suffix, fill, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                db.expiry(fixture.nextKey(), 3600 + static_cast<int>(i % 1000));
+            }
+        }});
+    }
+
+    // One list of each length, kept at that length
+    for (uint64_t length : {100, 10000, 100000}) {
+        std::string suffix = "/" + std::to_string(length);
+        auto fill = [length](Case&) { fillList(length); };
+        int middle = static_cast<int>(length / 2);
+        cases.push_back({"db/lpush+rpop" + suffix, fill, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                db.lpush("list", fixture.value);
+                std::string value = db.rpop("list");
+                keep(value);
+            }
+        }});
+        cases.push_back({"db/lindex-middle" + suffix, fill, [&db, middle](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                std::string value = db.lindex("list", middle);
+                keep(value);
+            }
+        }});
+        cases.push_back({"db/lset-middle" + suffix, fill, [&db, middle](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                db.lset("list", middle, fixture.value);
+            }
+        }});
+    }
+
+    // One hash of each size; 16 fields stays in the packed encoding
+    for (uint64_t fields : {16, 1000, 100000}) {
+        std::string suffix = "/" + std::to_string(fields);
+        auto fill = [fields](Case&) { fillHash(fields); };
+        cases.push_back({"db/hset" + suffix, fill, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                db.hset({"HSET", "hash", fixture.nextField(), fixture.value});
+            }
+        }});
+        cases.push_back({"db/hget" + suffix, fill, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                std::string value = db.hget("hash", fixture.nextField());
+                keep(value);
+            }
+        }});
+        cases.push_back({"db/hdel+hset" + suffix, fill, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                const std::string& field = fixture.nextField();
+                db.hdel("hash", field);
+                db.hset({"HSET", "hash", field, fixture.value});
+            }
+        }});
+        cases.push_back({"db/hgetall" + suffix, [fields](Case& self) {
+            fillHash(fields);
+            self.itemsPerOp = fields;
+        }, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                auto all = db.hgetall("hash");
+                keep(all);
+            }
+        }});
+    }
+
+    // Snapshot throughput, counted in keys and file bytes
+    for (uint64_t count : {10000, 100000}) {
+        std::string suffix = "/" + std::to_string(count);
+        cases.push_back({"snapshot/dump" + suffix, [count, &db](Case& self) {
+            fillMixed(count);
+            db.dumpDatabase(fixture.dumpFile);
+            self.itemsPerOp = count;
+            self.bytesPerOp = fileSize(fixture.dumpFile);
+        }, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                db.dumpDatabase(fixture.dumpFile);
+            }
+        }});
+        cases.push_back({"snapshot/load" + suffix, [count, &db](Case& self) {
+            fillMixed(count);
+            db.dumpDatabase(fixture.dumpFile);
+            self.itemsPerOp = count;
+            self.bytesPerOp = fileSize(fixture.dumpFile);
+        }, [&db](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                db.loadDatabase(fixture.dumpFile);
+            }
+        }});
+    }
+    return cases;
+}
+
+static void printHeader(const Options& options) {
+    if (options.csv) {
+        printf("\"case\",\"iterations\",\"median_ns\",\"min_ns\",\"mad_percent\",\"items_per_sec\",\"mb_per_sec\"\n");
+    } else {
+        printf("%-26s %12s %14s %14s %8s %16s %10s\n", "case", "iterations", "median ns/op", "min ns/op", "+/- mad", "items/s", "MB/s");
+    }
+}
+
+static void printResult(const Options& options, const Case& benchmark, const Result& result) {
+    double itemsPerSecond = result.medianNs > 0 ? benchmark.itemsPerOp * 1e9 / result.medianNs : 0;
+    double megabytesPerSecond = result.medianNs > 0 ? benchmark.bytesPerOp * 1e9 / result.medianNs / (1024 * 1024) : 0;
+    if (options.csv) {
+        printf("\"%s\",\"%llu\",\"%.1f\",\"%.1f\",\"%.2f\",\"%.0f\",\"%.1f\"\n", benchmark.name.c_str(),
+               static_cast<unsigned long long>(result.iterations), result.medianNs, result.minNs,
+               result.madPercent, itemsPerSecond, megabytesPerSecond);
+    } else {
+        std::string throughput = benchmark.bytesPerOp > 0 ? std::to_string(static_cast<uint64_t>(megabytesPerSecond)) : "-";
+        printf("%-26s %12llu %14.1f %14.1f %7.2f%% %16.0f %10s\n", benchmark.name.c_str(),
+               static_cast<unsigned long long>(result.iterations), result.medianNs, result.minNs,
+               result.madPercent, itemsPerSecond, throughput.c_str());
+    }
+    fflush(stdout);
+}
+
+static bool parseCount(const std::string& value, unsigned int& out) {
+    try {
+        size_t idx = 0;
+        long parsed = std::stol(value, &idx);
+        if (idx != value.size() || parsed < 0) {
+            return false;
+        }
+        out = static_cast<unsigned int>(parsed);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+static bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--csv") {
+            options.csv = true;
+            continue;
+        }
+        if (arg == "--list") {
+            options.list = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for option " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        unsigned int count;
+        if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--repetitions" && parseCount(value, count) && count > 0) {
+            options.repetitions = count;
+        } else if (arg == "--warmup" && parseCount(value, count)) {
+            options.warmup = count;
+        } else if (arg == "--min-time" && parseCount(value, count) && count > 0) {
+            options.minTime = std::chrono::milliseconds(count);
+        } else {
+            std::cerr << "Invalid option " << arg << " " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--filter substring] [--repetitions n] [--warmup n] [--min-time ms] [--csv] [--list]" << std::endl;
+        return 1;
+    }
+
+    // Loading a snapshot logs at info level, which would interleave with the table
+    Logger::getInstance().setLevel(LogLevel::Warning);
+
+    char directory[] = "/tmp/shaunstore-microbench-XXXXXX";
+    if (mkdtemp(directory) == nullptr) {
+        std::cerr << "Failed to create a temporary directory" << std::endl;
+        return 1;
+    }
+    fixture.dumpFile = std::string(directory) + "/dump";
+
+    std::vector<Case> cases = buildCases();
+    if (!options.list) {
+        printHeader(options);
+    }
+    for (Case& benchmark : cases) {
+        if (benchmark.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        if (options.list) {
+            printf("%s\n", benchmark.name.c_str());
+            continue;
+        }
+        fixture.next = 0;
+        if (benchmark.setup) {
+            benchmark.setup(benchmark);
+        }
+        printResult(options, benchmark, measure(options, benchmark));
+    }
+
+    Database::getInstance().flushAll();
+    unlink(fixture.dumpFile.c_str());
+    rmdir(directory);
+    return 0;
+}
@@ -0,0 +1,334 @@
+#include "../include/Aof.h"
+#include "../include/CommandHandler.h"
+#include "../include/Database.h"
+#include "../include/RespParser.h"
+#include "../include/Snapshot.h"
+#include "../include/Logger.h"
+#include "../include/LatencyMonitor.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+Aof& Aof::getInstance() {
+    static Aof instance;
+    return instance;
+}
+
+// Adds what made it to the file to done, so a caller can resume after a failure
+static bool writeAll(int fd, const char* data, size_t len, size_t& done) {
+    while (len > 0) {
+        ssize_t written = ::write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        len -= written;
+        done += written;
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const char* data, size_t len) {
+    size_t done = 0;
+    return writeAll(fd, data, len, done);
+}
+
+bool Aof::load(const std::string& filename) {
+    int file = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(file, &st) < 0) {
+        close(file);
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(file);
+        return true;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+
+    std::string_view log(static_cast<const char*>(mapped), st.st_size);
+    RespParser parser;
+    CommandHandler handler;
+    std::vector<std::string_view> tokens;
+    size_t pos = 0;
+    size_t commands = 0;
+    bool ok = true;
+
+    Database::getInstance().flushAll();
+    Database::getInstance().beginLoading();
+    while (pos < log.size()) {
+        size_t parsedLen = 0;
+        RespParser::Result result = parser.parse(log.substr(pos), tokens, parsedLen);
+        if (result == RespParser::Result::Complete) {
+            handler.replayCommand(tokens);
+            pos += parsedLen;
+            commands++;
+        } else if (result == RespParser::Result::Incomplete) {
+            // Crash in the middle of a write: keep what is complete and cut the rest off,
+            // so new appends do not land after a partial command
+            LOG_WARNING("Append only file " << filename << " ends with a partial command, truncating "
+                      << (log.size() - pos) << " bytes");
+            if (truncate(filename.c_str(), pos) < 0) {
+                ok = false;
+            }
+            break;
+        } else {
+            LOG_ERROR("Bad command in append only file " << filename << " at offset " << pos);
+            ok = false;
+            break;
+        }
+    }
+    munmap(mapped, st.st_size);
+    Database::getInstance().endLoading();
+
+    if (ok) {
+        LOG_INFO("Replayed " << commands << " commands from " << filename);
+    }
+    return ok;
+}
+
+bool Aof::open(const std::string& filename, FsyncPolicy policy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    fd = ::open(filename.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Error opening append only file " << filename);
+        return false;
+    }
+    this->filename = filename;
+    this->policy = policy;
+    stopping = false;
+    if (policy == FsyncPolicy::EverySec) {
+        fsyncThread = std::thread(&Aof::fsyncLoop, this);
+    }
+    enabled = true;
+    return true;
+}
+
+void Aof::append(std::initializer_list<std::string_view> args) {
+    if (isEnabled()) {
+        appendCommand(args);
+    }
+}
+
+void Aof::append(const std::vector<std::string_view>& args) {
+    if (isEnabled()) {
+        appendCommand(args);
+    }
+}
+
+template <typename Range>
+void Aof::appendCommand(const Range& args) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t start = buffer.size();
+    encodeCommand(buffer, args);
+    threadAppends++;
+    if (rewriting) {
+        rewriteBuffer.append(buffer, start, std::string::npos);
+    }
+}
+
+// Caller holds mutex
+bool Aof::writeBuffer() {
+    size_t written = 0;
+    bool ok = writeAll(fd, buffer.data(), buffer.size(), written);
+    // Only the part that did not make it is retried, so a short write does
+    // not leave a command in the file twice
+    buffer.erase(0, written);
+    return ok;
+}
+
+// Caller holds mutex. Logs the change of state only, not every failed retry.
+void Aof::setWriteStatus(bool ok) {
+    if (ok && !writeOk.load(std::memory_order_relaxed)) {
+        LOG_WARNING("Append only file " << filename << " is writable again, write commands are accepted");
+    } else if (!ok && writeOk.load(std::memory_order_relaxed)) {
+        LOG_ERROR("Error writing to append only file " << filename << ": " << std::strerror(errno)
+                  << ", write commands are refused until it succeeds");
+    }
+    writeOk.store(ok, std::memory_order_relaxed);
+}
+
+bool Aof::flush() {
+    if (!isEnabled()) {
+        return true;
+    }
+    bool ownWrites = threadAppends != threadFlushed;
+    threadFlushed = threadAppends;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (buffer.empty() && writeOk) {
+        return true; // Another event loop already committed our writes, and synced them if required
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool ok = writeBuffer();
+    if (ok && policy == FsyncPolicy::Always) {
+        ok = fdatasync(fd) == 0;
+    }
+    setWriteStatus(ok);
+    LatencyMonitor::getInstance().record("aof-flush", start);
+    // With the other policies the writes are not promised to be on disk before
+    // the reply; a thread that logged nothing this iteration has nothing to withhold
+    return ok || policy != FsyncPolicy::Always || !ownWrites;
+}
+
+void Aof::fsyncLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        fsyncWake.wait_for(lock, std::chrono::seconds(1));
+        if (stopping) {
+            break;
+        }
+        // Sync a duplicate outside the lock, so appends and flushes are not held
+        // up, and a rewrite can swap fd meanwhile
+        int file = dup(fd);
+        lock.unlock();
+        if (file >= 0) {
+            fdatasync(file);
+            close(file);
+        }
+        lock.lock();
+    }
+}
+
+bool Aof::backgroundRewrite() {
+    std::string target;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!isEnabled() || rewriting || rewritePid != -1) {
+            return false;
+        }
+        rewriting = true; // Claimed; the fork below fills in the rest
+        target = filename;
+    }
+
+    pid_t pid = Database::getInstance().forkConsistent(
+        [target] () {
+            return Database::getInstance().writeCommandLog(SnapshotWriter::tempFilenameFor(target, getpid()));
+        },
+        [this] (pid_t pid) {
+            // Every shard is still locked, so nothing has been logged since the fork
+            std::lock_guard<std::mutex> lock(mutex);
+            rewriteBuffer.clear();
+            rewritePid = pid;
+            rewriteStart = std::chrono::steady_clock::now();
+        });
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pid < 0) {
+        LOG_ERROR("Append only file rewrite failed: could not fork");
+        rewriting = false;
+        rewritePid = -1;
+        return false;
+    }
+    LOG_INFO("Background append only file rewriting started by pid " << pid);
+    return true;
+}
+
+bool Aof::rewriteInProgress() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rewriting || rewritePid != -1;
+}
+
+void Aof::cron() {
+    pid_t pid;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pid = rewritePid;
+    }
+    if (pid <= 0) {
+        return;
+    }
+
+    int status;
+    pid_t finished = waitpid(pid, &status, WNOHANG);
+    if (finished == 0) {
+        return; // Still running
+    }
+    if (finished > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        finishRewrite(pid);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    LOG_ERROR("Background append only file rewrite failed");
+    unlink(SnapshotWriter::tempFilenameFor(filename, pid).c_str());
+    rewriteBuffer.clear();
+    rewriting = false;
+    rewritePid = -1;
+}
+
+// Appends the changes made during the rewrite to the child's file and swaps it in
+void Aof::finishRewrite(pid_t pid) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string temp = SnapshotWriter::tempFilenameFor(filename, pid);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - rewriteStart);
+
+    int newFd = ::open(temp.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    bool ok = newFd >= 0 &&
+              writeAll(newFd, rewriteBuffer.data(), rewriteBuffer.size()) &&
+              fdatasync(newFd) == 0 &&
+              rename(temp.c_str(), filename.c_str()) == 0;
+
+    if (ok) {
+        close(fd);
+        fd = newFd;
+        // Whatever was still buffered is either in the child's dataset (logged
+        // before the fork) or in rewriteBuffer (after it)
+        buffer.clear();
+        LOG_INFO("Background append only file rewrite terminated with success in "
+                  << elapsed.count() << " ms");
+    } else {
+        if (newFd >= 0) {
+            close(newFd);
+        }
+        unlink(temp.c_str());
+        LOG_ERROR("Failed to install the rewritten append only file");
+    }
+    rewriteBuffer.clear();
+    rewriting = false;
+    rewritePid = -1;
+}
+
+void Aof::shutdown() {
+    if (!isEnabled()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (rewritePid > 0) {
+            kill(rewritePid, SIGKILL);
+            waitpid(rewritePid, nullptr, 0);
+            unlink(SnapshotWriter::tempFilenameFor(filename, rewritePid).c_str());
+            rewritePid = -1;
+            rewriting = false;
+            rewriteBuffer.clear();
+        }
+        writeBuffer();
+        fdatasync(fd);
+        stopping = true;
+        enabled = false;
+    }
+    fsyncWake.notify_all();
+    if (fsyncThread.joinable()) {
+        fsyncThread.join();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    close(fd);
+    fd = -1;
+}
@@ -1,201 +1,102 @@
 #include "../include/CommandHandler.h"
 #include "../include/Database.h"
+#include "../include/Aof.h"
+#include "../include/Persistence.h"
+#include "../include/Slab.h"
+#include "../include/Stats.h"
+#include "../include/SlowLog.h"
+#include "../include/LatencyMonitor.h"
 #include <string>
 #include <sstream>
 #include <vector>
-#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <unordered_map>
+#include <charconv>
+#include <climits>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
 
 CommandHandler::CommandHandler(){};
 
-bool CommandHandler::parseSimpleString(const std::string& buffer, std::vector<std::string>& parsedCommand, size_t& pos) {
-    if (pos >= buffer.size() || buffer[pos] != '+') {
-        return false; // Invalid format
+// Parses a decimal integer from a view, without allocating
+static bool parseNumber(std::string_view text, long long& value) {
+    if (text.empty()) {
+        return false;
     }
-    pos++; // Skip the '+'
-    size_t endPos = buffer.find("\r\n", pos);
-    if (endPos == std::string::npos) {
-        return false; // Invalid format
-    }
-    parsedCommand.push_back(buffer.substr(pos, endPos - pos));
-    return true;
-}
-
-bool CommandHandler::parseBulkString(const std::string& buffer, std::vector<std::string>& parsedCommand, size_t& pos) {
-    if (pos >= buffer.size() || buffer[pos] != '$') {
-        return false; // Invalid format
-    }
-    pos++; // Skip the '$'
-    size_t crlf = buffer.find("\r\n", pos);
-    if (crlf == std::string::npos) {
-        return false; // Invalid format
-    }
-    int length = std::stoi(buffer.substr(pos, crlf - pos));
-    pos = crlf + 2; // Move past \r\n
-    if (length < 0) {
-        parsedCommand.push_back(""); // Null bulk string
-    } else {
-        if (pos + length > buffer.size()) {
-            return false; // Invalid format
-        }
-        parsedCommand.push_back(buffer.substr(pos, length));
-        pos += length + 2; // Move past the string and \r\n
-    }
-    return true;
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
 }
 
-bool CommandHandler::parseInteger(const std::string& buffer, std::vector<std::string>& parsedCommand, size_t& pos) {
-    if (pos >= buffer.size() || buffer[pos] != ':') {
-        return false; // Invalid format
-    }
-    pos++; // Skip the ':'
-    size_t endPos = buffer.find("\r\n", pos);
-    if (endPos == std::string::npos) {
-        return false; // Invalid format
+static bool parseNumber(std::string_view text, int& value) {
+    long long parsed;
+    if (!parseNumber(text, parsed) || parsed < INT_MIN || parsed > INT_MAX) {
+        return false;
     }
-    parsedCommand.push_back(buffer.substr(pos, endPos - pos));
-    pos = endPos + 2; // Move past \r\n
+    value = static_cast<int>(parsed);
     return true;
 }
 
-bool CommandHandler::parseError(const std::string& buffer, std::vector<std::string>& parsedCommand, size_t& pos) {
-    if (pos >= buffer.size() || buffer[pos] != '-') {
-        return false; // Invalid format
-    }
-    pos++; // Skip the '-'
-    size_t endPos = buffer.find("\r\n", pos);
-    if (endPos == std::string::npos) {
-        return false; // Invalid format
-    }
-    parsedCommand.push_back(buffer.substr(pos, endPos - pos));
-    pos = endPos + 2; // Move past \r\n
-    return true;
+// RESP bulk string reply
+static std::string bulkString(std::string_view value) {
+    std::string reply;
+    reply.reserve(value.size() + 16);
+    reply += '$';
+    reply += std::to_string(value.size());
+    reply += "\r\n";
+    reply += value;
+    reply += "\r\n";
+    return reply;
 }
 
-bool CommandHandler::parseArray(const std::string& buffer, std::vector<std::string>& parsedCommand, size_t& pos) {
-    if (pos >= buffer.size() || buffer[pos] != '*') {
-        return false; // Invalid format
-    }
-    pos++; // Skip the '*'
-    size_t crlf = buffer.find("\r\n", pos);
-    if (crlf == std::string::npos) {
-        return false; // Invalid format
-    }
-    int numElements = std::stoi(buffer.substr(pos, crlf - pos));
-    pos = crlf + 2; // Move past \r\n
-
-    for (int i = 0; i < numElements; i++) {
-        if (pos >= buffer.size()) {
-            return false; // Invalid format
-        }
-        if (buffer[pos] == '$') {
-            if (!parseBulkString(buffer, parsedCommand, pos)) {
-                return false; // Invalid format
-            }
-        } else if (buffer[pos] == '+') {
-            if (!parseSimpleString(buffer, parsedCommand, pos)) {
-                return false; // Invalid format
-            }
-        } else if (buffer[pos] == ':') {
-            if (!parseInteger(buffer, parsedCommand, pos)) {
-                return false; // Invalid format
-            }
-        } else if (buffer[pos] == '-') {
-            if (!parseError(buffer, parsedCommand, pos)) {
-                return false; // Invalid format
-            }
-        } else if (buffer[pos] == '*') {
-            if (!parseArray(buffer, parsedCommand, pos)) {
-                return false;
-            }
-        }
-        else {
-            return false; // Invalid RESP format
-        }
-    }
-    return true;
+static constexpr char toLowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
 }
 
-bool CommandHandler::parseRESP(const std::string& buffer, std::vector<std::string>& parsedCommand, size_t& parsedLen) {
-    parsedCommand.clear();
-    parsedLen = 0;
-
-    if (buffer.empty()) {
-        return false; // Empty buffer
+static bool equalsIgnoreCase(std::string_view lowercase, std::string_view name) {
+    if (lowercase.size() != name.size()) {
+        return false;
     }
-    std::cout << "Parsing RESP: " << buffer << std::endl;
-    size_t pos = 0;
-    if (buffer[pos] == '*') {
-        if (!parseArray(buffer, parsedCommand, pos)) {
-            return false; // Invalid RESP format
-        }
-    } else if (buffer[pos] == '$') {
-        if (!parseBulkString(buffer, parsedCommand, pos)) {
-            return false; // Invalid RESP format
-        }
-    } else if (buffer[pos] == '+') {
-        if (!parseSimpleString(buffer, parsedCommand, pos)) {
-            return false; // Invalid RESP format
-        }
-    } else if (buffer[pos] == ':') {
-        if (!parseInteger(buffer, parsedCommand, pos)) {
-            return false; // Invalid RESP format
+    for (size_t i = 0; i < name.size(); i++) {
+        if (lowercase[i] != toLowerAscii(name[i])) {
+            return false;
         }
-    } else if (buffer[pos] == '-') {
-        if (!parseError(buffer, parsedCommand, pos)) {
-            return false; // Invalid RESP format
-        }
-    } else {
-        return false; // Invalid RESP format
-    }
-
-    parsedLen = pos; // Set parsed length to current position
-    std::cout << "Parsed RESP length: " << parsedLen << std::endl;
-    std::cout << "Parsed RESP tokens: ";
-    for (const auto& token : parsedCommand) {
-        std::cout << token << " ";
     }
     return true;
 }
 
-std::string CommandHandler::handlePing(const std::vector<std::string>& args, Database& db) {
+std::string CommandHandler::handlePing(const std::vector<std::string_view>& args, Database& db) {
     return "+PONG\r\n"; // RESP format for PING command
 }
 
-std::string CommandHandler::handleEcho(const std::vector<std::string>& args, Database& db) {
-    if (args.size() != 2) {
-        return "-ERR: Wrong number of arguments for 'echo' command\r\n"; // Return error in RESP format
-    }
-    return "$" + std::to_string(args[1].size()) + "\r\n" + args[1] + "\r\n"; // RESP format for ECHO command
+std::string CommandHandler::handleEcho(const std::vector<std::string_view>& args, Database& db) {
+    return bulkString(args[1]); // RESP format for ECHO command
 }
 
-std::string CommandHandler::handleFlushAll(const std::vector<std::string>& args, Database& db) {
+std::string CommandHandler::handleFlushAll(const std::vector<std::string_view>& args, Database& db) {
     db.flushAll();
     return "+OK\r\n"; // RESP format for successful FLUSHALL command
 }
 
-std::string CommandHandler::handleSet(const std::vector<std::string>& args, Database& db) {
-    if (args.size() != 3) {
-        return "-ERR: Wrong number of arguments for 'set' command\r\n"; // Return error in RESP format
-    }
+std::string CommandHandler::handleSet(const std::vector<std::string_view>& args, Database& db) {
     db.set(args[1], args[2]);
     return "+OK\r\n"; // RESP format for successful SET command
 }
 
-std::string CommandHandler::handleGet(const std::vector<std::string>& args, Database& db) {
-    if (args.size() != 2) {
-        return "-ERR: Wrong number of arguments for 'get' command\r\n"; // Return error in RESP format
-    }
+std::string CommandHandler::handleGet(const std::vector<std::string_view>& args, Database& db) {
     std::string value = db.get(args[1]);
     if (value.empty()) {
         return "$-1\r\n"; // Null bulk string for non-existing key
     }
-    return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n"; // RESP format for GET command
+    return bulkString(value); // RESP format for GET command
 }
 
-std::string CommandHandler::handleKeys(const std::vector<std::string>& args, Database& db) {
-    std::vector<std::string> keys = db.keys();
+// KEYS [pattern], all keys when no pattern is given
+std::string CommandHandler::handleKeys(const std::vector<std::string_view>& args, Database& db) {
+    std::vector<std::string> keys = db.keys(args.size() > 1 ? args[1] : "*");
     std::ostringstream response;
     response << "*" << keys.size() << "\r\n";
     for (const auto& key : keys) {
@@ -204,61 +105,323 @@ std::string CommandHandler::handleKeys(const std::vector<std::string>& args, Dat
     return response.str();
 }
 
-std::string CommandHandler::handleType(const std::vector<std::string>& args, Database& db) {
-    if (args.size() != 2) {
-        return "-ERR: Wrong number of arguments for 'type' command\r\n"; // Return error in RESP format
+static bool parseCursor(std::string_view text, uint64_t& cursor) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, cursor);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+// [MATCH pattern] [COUNT n] from args[first] on
+static bool parseScanOptions(const std::vector<std::string_view>& args, size_t first, std::string_view& pattern, size_t& count) {
+    for (size_t i = first; i < args.size(); i += 2) {
+        if (i + 1 >= args.size()) {
+            return false;
+        }
+        long long value;
+        if (equalsIgnoreCase("match", args[i])) {
+            pattern = args[i + 1];
+        } else if (equalsIgnoreCase("count", args[i]) && parseNumber(args[i + 1], value) && value > 0) {
+            count = static_cast<size_t>(value);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static constexpr size_t SCAN_DEFAULT_COUNT = 10;
+
+// SCAN cursor [MATCH pattern] [COUNT n]: start with cursor 0 and pass back
+// the returned cursor until it is 0 again
+std::string CommandHandler::handleScan(const std::vector<std::string_view>& args, Database& db) {
+    uint64_t cursor;
+    if (!parseCursor(args[1], cursor)) {
+        return "-ERR: invalid cursor\r\n";
+    }
+    std::string_view pattern = "*";
+    size_t count = SCAN_DEFAULT_COUNT;
+    if (!parseScanOptions(args, 2, pattern, count)) {
+        return "-ERR: syntax error\r\n";
+    }
+
+    std::vector<std::string> keys;
+    uint64_t next = db.scan(cursor, count, pattern, keys);
+    std::string response = "*2\r\n" + bulkString(std::to_string(next));
+    response += "*" + std::to_string(keys.size()) + "\r\n";
+    for (const auto& key : keys) {
+        response += bulkString(key);
     }
+    return response;
+}
+
+std::string CommandHandler::handleType(const std::vector<std::string_view>& args, Database& db) {
     std::string type = db.type(args[1]);
     return "+TYPE " + type + "\r\n"; // RESP format for TYPE command
 }
 
-std::string CommandHandler::handleDel(const std::vector<std::string>& args, Database& db) {
-    if (args.size() != 2) {
-        return "-ERR: Wrong number of arguments for 'del' command\r\n"; // Return error in RESP format
-    }
+std::string CommandHandler::handleDel(const std::vector<std::string_view>& args, Database& db) {
     bool deleted = db.del(args[1]);
     return (deleted ? ":1\r\n" : ":0\r\n"); // RESP format for DEL command
 }
 
-std::string CommandHandler::handleExists(const std::vector<std::string>& args, Database& db) {
-    if (args.size() != 2) {
-        return "-ERR: Wrong number of arguments for 'exists' command\r\n"; // Return error in RESP format
-    }
+std::string CommandHandler::handleExists(const std::vector<std::string_view>& args, Database& db) {
     bool exists = db.exists(args[1]);
     return (exists ? ":1\r\n" : ":0\r\n"); // RESP format for EXISTS command
 }
 
-std::string CommandHandler::handleRename(const std::vector<std::string>& args, Database& db) {
-    if (args.size() != 3) {
-        return "-ERR: Wrong number of arguments for 'rename' command\r\n"; // Return error in RESP format
-    }
+std::string CommandHandler::handleRename(const std::vector<std::string_view>& args, Database& db) {
     bool renamed = db.rename(args[1], args[2]);
     return (renamed ? "+OK\r\n" : "-ERR: Key does not exist\r\n"); // RESP format for RENAME command
 }
 
-std::string CommandHandler::handleExpiry(const std::vector<std::string>& args, Database& db) {
-    if (args.size() != 3) {
-        return "-ERR: Wrong number of arguments for 'expire' command\r\n"; // Return error in RESP format
+std::string CommandHandler::handleExpiry(const std::vector<std::string_view>& args, Database& db) {
+    int seconds;
+    if (!parseNumber(args[2], seconds)) {
+        return "-ERR: value is not an integer or out of range\r\n";
     }
-    int seconds = std::stoi(args[2]);
     bool expirySet = db.expiry(args[1], seconds);
     return (expirySet ? "+OK\r\n" : "-ERR: Key does not exist\r\n"); // RESP format for EXPIRE command
 }
 
-std::string CommandHandler::handleLlen(const std::vector<std::string> &args, Database& db) {
-    if (args.size() < 2) 
-        return "-Error: LLEN requires key\r\n";
+std::string CommandHandler::handlePexpireat(const std::vector<std::string_view>& args, Database& db) {
+    long long unixMillis;
+    if (!parseNumber(args[2], unixMillis) || unixMillis < 0) {
+        return "-ERR: value is not an integer or out of range\r\n";
+    }
+    bool expirySet = db.expireAt(args[1], static_cast<uint64_t>(unixMillis));
+    return (expirySet ? "+OK\r\n" : "-ERR: Key does not exist\r\n"); // Same replies as EXPIRE
+}
+
+std::string CommandHandler::handleBgrewriteaof(const std::vector<std::string_view>& args, Database& db) {
+    (void)args;
+    (void)db;
+    if (!Aof::getInstance().isEnabled()) {
+        return "-ERR: Append only file is disabled\r\n";
+    }
+    if (!Aof::getInstance().backgroundRewrite()) {
+        return "-ERR: Background append only file rewriting already in progress\r\n";
+    }
+    return "+Background append only file rewriting started\r\n";
+}
+
+std::string CommandHandler::handleBgsave(const std::vector<std::string_view>& args, Database& db) {
+    (void)args;
+    (void)db;
+    if (!Persistence::getInstance().backgroundSave()) {
+        return "-ERR: Background save already in progress\r\n";
+    }
+    return "+Background saving started\r\n";
+}
+
+std::string CommandHandler::handleLastsave(const std::vector<std::string_view>& args, Database& db) {
+    (void)args;
+    (void)db;
+    return ":" + std::to_string(Persistence::getInstance().lastSaveTime()) + "\r\n";
+}
+
+static std::string_view policyName(EvictionPolicy policy) {
+    switch (policy) {
+        case EvictionPolicy::NoEviction: return "noeviction";
+        case EvictionPolicy::AllKeysLru: return "allkeys-lru";
+        case EvictionPolicy::AllKeysLfu: return "allkeys-lfu";
+        case EvictionPolicy::VolatileTtl: return "volatile-ttl";
+    }
+    return "";
+}
+
+static void appendCommandStats(std::string& info, const std::vector<Stats::CommandSummary>& summaries, bool percentiles);
+
+// Sections are separated by a blank line, as clients that parse INFO expect
+static void startSection(std::string& info, std::string_view title) {
+    if (!info.empty()) {
+        info += "\r\n";
+    }
+    info += "# ";
+    info += title;
+    info += "\r\n";
+}
+
+// INFO [section ...]: server, clients, memory, persistence, stats and
+// keyspace by default; commandstats and latencystats only when named or
+// with "all"
+std::string CommandHandler::handleInfo(const std::vector<std::string_view>& args, Database& db) {
+    auto wants = [&args](std::string_view section, bool byDefault) {
+        if (args.size() < 2) {
+            return byDefault;
+        }
+        for (size_t i = 1; i < args.size(); i++) {
+            if (equalsIgnoreCase(section, args[i]) || equalsIgnoreCase("all", args[i]) ||
+                equalsIgnoreCase("everything", args[i]) || (byDefault && equalsIgnoreCase("default", args[i]))) {
+                return true;
+            }
+        }
+        return false;
+    };
+    Stats& stats = Stats::getInstance();
+    std::string info;
+
+    if (wants("server", true)) {
+        startSection(info, "Server");
+        info += "process_id:" + std::to_string(getpid()) + "\r\n";
+        info += "tcp_port:" + std::to_string(stats.getPort()) + "\r\n";
+        info += "io_backend:" + stats.getIoBackend() + "\r\n";
+        info += "event_loops:" + std::to_string(stats.getEventLoops()) + "\r\n";
+        info += "uptime_in_seconds:" + std::to_string(stats.uptimeSeconds()) + "\r\n";
+        info += "uptime_in_days:" + std::to_string(stats.uptimeSeconds() / 86400) + "\r\n";
+    }
+    if (wants("clients", true)) {
+        startSection(info, "Clients");
+        info += "connected_clients:" + std::to_string(stats.connectedClients()) + "\r\n";
+    }
+    if (wants("memory", true)) {
+        startSection(info, "Memory");
+        info += "used_memory:" + std::to_string(db.usedMemory()) + "\r\n";
+        info += "slab_memory:" + std::to_string(Slab::pageBytes()) + "\r\n"; // Pages held by the allocator, free blocks included
+        info += "maxmemory:" + std::to_string(db.getMaxMemory()) + "\r\n";
+        info += "maxmemory_policy:";
+        info += policyName(db.getEvictionPolicy());
+        info += "\r\n";
+        info += "evicted_keys:" + std::to_string(db.evictedCount()) + "\r\n";
+    }
+    if (wants("persistence", true)) {
+        Persistence& persistence = Persistence::getInstance();
+        Aof& aof = Aof::getInstance();
+        startSection(info, "Persistence");
+        info += "rdb_changes_since_last_save:" + std::to_string(persistence.changesSinceLastSave()) + "\r\n";
+        info += "rdb_bgsave_in_progress:" + std::to_string(persistence.saveInProgress()) + "\r\n";
+        info += "rdb_last_save_time:" + std::to_string(persistence.lastSaveTime()) + "\r\n";
+        info += std::string("rdb_last_bgsave_status:") + (persistence.lastSaveSucceeded() ? "ok" : "err") + "\r\n";
+        info += "aof_enabled:" + std::to_string(aof.isEnabled()) + "\r\n";
+        info += "aof_rewrite_in_progress:" + std::to_string(aof.rewriteInProgress()) + "\r\n";
+    }
+
+    bool commandStats = wants("commandstats", false);
+    bool latencyStats = wants("latencystats", false);
+    std::vector<Stats::CommandSummary> summaries;
+    if (wants("stats", true) || commandStats || latencyStats) {
+        summaries = stats.commandSummaries();
+    }
+    if (wants("stats", true)) {
+        uint64_t commands = 0;
+        for (const auto& summary : summaries) {
+            commands += summary.calls;
+        }
+        startSection(info, "Stats");
+        info += "total_connections_received:" + std::to_string(stats.totalConnections()) + "\r\n";
+        info += "total_commands_processed:" + std::to_string(commands) + "\r\n";
+        info += "rejected_connections:" + std::to_string(stats.rejectedConnections()) + "\r\n";
+    }
+    if (wants("keyspace", true)) {
+        size_t keys, expires;
+        db.keyspaceCounts(keys, expires);
+        startSection(info, "Keyspace");
+        if (keys > 0) {
+            info += "db0:keys=" + std::to_string(keys) + ",expires=" + std::to_string(expires) + "\r\n";
+        }
+    }
+    if (commandStats) {
+        startSection(info, "Commandstats");
+        appendCommandStats(info, summaries, false);
+    }
+    if (latencyStats) {
+        startSection(info, "Latencystats");
+        appendCommandStats(info, summaries, true);
+    }
+    return bulkString(info);
+}
+
+// MEMORY USAGE key
+std::string CommandHandler::handleMemory(const std::vector<std::string_view>& args, Database& db) {
+    if (!equalsIgnoreCase("usage", args[1])) {
+        return "-ERR: Unknown MEMORY subcommand\r\n";
+    }
+    if (args.size() != 3) {
+        return "-ERR: Wrong number of arguments for 'memory usage' command\r\n";
+    }
+    std::optional<size_t> usage = db.memoryUsage(args[2]);
+    if (!usage) {
+        return "$-1\r\n"; // Null bulk string for non-existing key
+    }
+    return ":" + std::to_string(*usage) + "\r\n";
+}
+
+// SLOWLOG GET [count] | LEN | RESET
+std::string CommandHandler::handleSlowlog(const std::vector<std::string_view>& args, Database& db) {
+    (void)db;
+    SlowLog& slowLog = SlowLog::getInstance();
+    if (equalsIgnoreCase("len", args[1]) && args.size() == 2) {
+        return ":" + std::to_string(slowLog.length()) + "\r\n";
+    }
+    if (equalsIgnoreCase("reset", args[1]) && args.size() == 2) {
+        slowLog.reset();
+        return "+OK\r\n";
+    }
+    if (!equalsIgnoreCase("get", args[1]) || args.size() > 3) {
+        return "-ERR: Unknown SLOWLOG subcommand or wrong number of arguments\r\n";
+    }
+    long long count = 10;
+    if (args.size() == 3 && !parseNumber(args[2], count)) {
+        return "-ERR: value is not an integer or out of range\r\n";
+    }
+
+    // Each entry: id, Unix time, microseconds, arguments
+    std::vector<SlowLog::Entry> entries = slowLog.get(count < 0 ? SIZE_MAX : static_cast<size_t>(count));
+    std::string reply = "*" + std::to_string(entries.size()) + "\r\n";
+    for (const auto& entry : entries) {
+        reply += "*4\r\n";
+        reply += ":" + std::to_string(entry.id) + "\r\n";
+        reply += ":" + std::to_string(entry.time) + "\r\n";
+        reply += ":" + std::to_string(entry.micros) + "\r\n";
+        reply += "*" + std::to_string(entry.args.size()) + "\r\n";
+        for (const auto& arg : entry.args) {
+            reply += bulkString(arg);
+        }
+    }
+    return reply;
+}
+
+// LATENCY LATEST | HISTORY event | RESET [event ...]
+std::string CommandHandler::handleLatency(const std::vector<std::string_view>& args, Database& db) {
+    (void)db;
+    LatencyMonitor& monitor = LatencyMonitor::getInstance();
+    if (equalsIgnoreCase("latest", args[1]) && args.size() == 2) {
+        // Each event: name, Unix time of the latest sample, its milliseconds, the worst milliseconds
+        std::vector<LatencyMonitor::EventSummary> events = monitor.latest();
+        std::string reply = "*" + std::to_string(events.size()) + "\r\n";
+        for (const auto& event : events) {
+            reply += "*4\r\n";
+            reply += bulkString(event.name);
+            reply += ":" + std::to_string(event.latest.time) + "\r\n";
+            reply += ":" + std::to_string(event.latest.millis) + "\r\n";
+            reply += ":" + std::to_string(event.maxMillis) + "\r\n";
+        }
+        return reply;
+    }
+    if (equalsIgnoreCase("history", args[1]) && args.size() == 3) {
+        std::vector<LatencyMonitor::Sample> samples = monitor.history(args[2]);
+        std::string reply = "*" + std::to_string(samples.size()) + "\r\n";
+        for (const auto& sample : samples) {
+            reply += "*2\r\n";
+            reply += ":" + std::to_string(sample.time) + "\r\n";
+            reply += ":" + std::to_string(sample.millis) + "\r\n";
+        }
+        return reply;
+    }
+    if (equalsIgnoreCase("reset", args[1])) {
+        std::vector<std::string_view> events(args.begin() + 2, args.end());
+        return ":" + std::to_string(monitor.reset(events)) + "\r\n";
+    }
+    return "-ERR: Unknown LATENCY subcommand or wrong number of arguments\r\n";
+}
 
+std::string CommandHandler::handleLlen(const std::vector<std::string_view> &args, Database& db) {
     ssize_t len = db.llen(args[1]);
     if (len < 0) 
         return "-Error: Key does not exist or is not a list\r\n";
     return ":" + std::to_string(len) + "\r\n";
 }
 
-std::string CommandHandler::handleLget(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 2) 
-        return "-Error: LGET requires key\r\n";
-
+std::string CommandHandler::handleLget(const std::vector<std::string_view> &args, Database &db) {
     std::vector<std::string> list = db.lget(args[1]);
     if (list.empty()) 
         return "-Error: Key does not exist or is not a list\r\n";
@@ -270,112 +433,98 @@ std::string CommandHandler::handleLget(const std::vector<std::string> &args, Dat
     return response.str(); // RESP format for LGET command
 }
 
-std::string CommandHandler::handleLpush(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 3) 
-        return "-Error: LPUSH requires key and value\r\n";
-
+std::string CommandHandler::handleLpush(const std::vector<std::string_view> &args, Database &db) {
     for (size_t i = 2; i < args.size(); ++i) {
-        db.lpush(args[1], args[i]);
+        if (!db.lpush(args[1], args[i])) {
+            return "-Error: Key holds a value that is not a list\r\n";
+        }
     }
     ssize_t len = db.llen(args[1]);
     return ":" + std::to_string(len) + "\r\n";
 }
 
-std::string CommandHandler::handleRpush(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 3) 
-        return "-Error: RPUSH requires key and value\r\n";
-
+std::string CommandHandler::handleRpush(const std::vector<std::string_view> &args, Database &db) {
     for (size_t i = 2; i < args.size(); ++i) {
-        db.rpush(args[1], args[i]);
+        if (!db.rpush(args[1], args[i])) {
+            return "-Error: Key holds a value that is not a list\r\n";
+        }
     }
     ssize_t len = db.llen(args[1]);
     return ":" + std::to_string(len) + "\r\n";
 }
 
-std::string CommandHandler::handleLpop(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 2) 
-        return "-Error: LPOP requires key\r\n";
-
+std::string CommandHandler::handleLpop(const std::vector<std::string_view> &args, Database &db) {
     std::string value = db.lpop(args[1]);
     if (value.empty()) 
         return "$-1\r\n"; // Null bulk string for non-existing key
-    return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n"; // RESP format for LPOP command
+    return bulkString(value); // RESP format for LPOP command
 }
 
-std::string CommandHandler::handleRpop(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 2) 
-        return "-Error: RPOP requires key\r\n";
+std::string CommandHandler::handleRpop(const std::vector<std::string_view> &args, Database &db) {
     
     std::string value = db.rpop(args[1]);
     if (value.empty()) 
         return "$-1\r\n"; // Null bulk string for non-existing key
-    return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n"; // RESP format for RPOP command
+    return bulkString(value); // RESP format for RPOP command
 }
 
-std::string CommandHandler::handleLrem(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 4) 
-        return "-Error: LREM requires key, count and value\r\n";
-
-    try {
-        int count = std::stoi(args[2]);
-        int removed = db.lrem(args[1], count, args[3]);
-        return ":" + std::to_string(removed) + "\r\n";
-    } catch (const std::exception&) {
+std::string CommandHandler::handleLrem(const std::vector<std::string_view> &args, Database &db) {
+    int count;
+    if (!parseNumber(args[2], count)) {
         return "-Error: Invalid count\r\n";
     }
+    int removed = db.lrem(args[1], count, args[3]);
+    return ":" + std::to_string(removed) + "\r\n";
 }
 
-std::string CommandHandler::handleLindex(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 3) 
-        return "-Error: LINDEX requires key and index\r\n";
-
-    std::string value = db.lindex(args[1], std::stoi(args[2]));
+std::string CommandHandler::handleLindex(const std::vector<std::string_view> &args, Database &db) {
+    int index;
+    if (!parseNumber(args[2], index)) {
+        return "-Error: Invalid index\r\n";
+    }
+    std::string value = db.lindex(args[1], index);
 
     if (value.empty()) {
         return "$-1\r\n"; // Null bulk string for non-existing key or index out of range
     }
-    return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n"; // RESP format for LINDEX command
+    return bulkString(value); // RESP format for LINDEX command
 }
 
-std::string CommandHandler::handleLset(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 4) 
-        return "-Error: LSET requires key, index and value\r\n";
-
-    if (!db.lset(args[1], std::stoi(args[2]), args[3])) {
+std::string CommandHandler::handleLset(const std::vector<std::string_view> &args, Database &db) {
+    int index;
+    if (!parseNumber(args[2], index)) {
+        return "-Error: Invalid index\r\n";
+    }
+    if (!db.lset(args[1], index, args[3])) {
         return "-Error: Key does not exist or index out of range\r\n"; // Return error in RESP format
     }
     return "+OK\r\n"; // RESP format for successful LSET command
 }
 
-std::string CommandHandler::handleHset(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 4) 
-        return "-Error: HSET requires key, field and value\r\n";
+std::string CommandHandler::handleHset(const std::vector<std::string_view> &args, Database &db) {
+    if (args.size() % 2 != 0) {
+        return "-ERR: Wrong number of arguments for 'hset' command\r\n"; // Field without a value
+    }
 
     size_t numInserts = db.hset(args);
 
     if (numInserts <= 0) {
-        return "-Error: Key does not exist\r\n"; // Return error in RESP format
+        return "-Error: Key holds a value that is not a hash\r\n"; // Return error in RESP format
     }
     else {
         return ":" + std::to_string(numInserts) + "\r\n"; // Multiple fields were added
     }
 }
 
-std::string CommandHandler::handleHget(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 3) 
-        return "-Error: HGET requires key and field\r\n";
-
+std::string CommandHandler::handleHget(const std::vector<std::string_view> &args, Database &db) {
     std::string value = db.hget(args[1], args[2]);
     if (value.empty()) {
         return "$-1\r\n"; // Null bulk string for non-existing key or field
     }
-    return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n"; // RESP format for HGET command
+    return bulkString(value); // RESP format for HGET command
 }
 
-std::string CommandHandler::handleHdel(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 3) 
-        return "-Error: HDEL requires key and field\r\n";
-
+std::string CommandHandler::handleHdel(const std::vector<std::string_view> &args, Database &db) {
     size_t numDeleted = db.hdel(args[1], args[2]);
     if (numDeleted <= 0) {
         return "-Error: Key does not exist or field does not exist\r\n";
@@ -383,19 +532,36 @@ std::string CommandHandler::handleHdel(const std::vector<std::string> &args, Dat
     return ":" + std::to_string(numDeleted) + "\r\n";
 }
 
-std::string CommandHandler::handleHexists(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 3) 
-        return "-Error: HEXISTS requires key and field\r\n";
-
+std::string CommandHandler::handleHexists(const std::vector<std::string_view> &args, Database &db) {
     bool exists = db.hexists(args[1], args[2]);
     return (exists ? ":1\r\n" : ":0\r\n"); // RESP format for HEXISTS command
 }
 
-std::string CommandHandler::handleHgetall(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 2) 
-        return "-Error: HGETALL requires key\r\n";
+// HSCAN key cursor [MATCH pattern] [COUNT n], fields and values interleaved like HGETALL
+std::string CommandHandler::handleHscan(const std::vector<std::string_view> &args, Database &db) {
+    uint64_t cursor;
+    if (!parseCursor(args[2], cursor)) {
+        return "-ERR: invalid cursor\r\n";
+    }
+    std::string_view pattern = "*";
+    size_t count = SCAN_DEFAULT_COUNT;
+    if (!parseScanOptions(args, 3, pattern, count)) {
+        return "-ERR: syntax error\r\n";
+    }
+
+    std::vector<std::pair<std::string, std::string>> fields;
+    uint64_t next = db.hscan(args[1], cursor, count, pattern, fields);
+    std::string response = "*2\r\n" + bulkString(std::to_string(next));
+    response += "*" + std::to_string(fields.size() * 2) + "\r\n";
+    for (const auto& [field, value] : fields) {
+        response += bulkString(field);
+        response += bulkString(value);
+    }
+    return response;
+}
 
-    std::unordered_map<std::string, std::string> hash = db.hgetall(args[1]);
+std::string CommandHandler::handleHgetall(const std::vector<std::string_view> &args, Database &db) {
+    StringMap<std::string> hash = db.hgetall(args[1]);
     if (hash.empty()) {
         return "-Error: Key does not exist or is not a hash\r\n"; // Return error in RESP format
     }
@@ -409,10 +575,7 @@ std::string CommandHandler::handleHgetall(const std::vector<std::string> &args,
     return response.str(); // RESP format for HGETALL command
 }
 
-std::string CommandHandler::handleHkeys(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 2) 
-        return "-Error: HKEYS requires key\r\n";
-
+std::string CommandHandler::handleHkeys(const std::vector<std::string_view> &args, Database &db) {
     std::vector<std::string> keys = db.hkeys(args[1]);
     if (keys.empty()) {
         return "-Error: Key does not exist or is not a hash\r\n"; // Return error in RESP format
@@ -426,10 +589,7 @@ std::string CommandHandler::handleHkeys(const std::vector<std::string> &args, Da
     return response.str();
 }
 
-std::string CommandHandler::handleHvals(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 2) 
-        return "-Error: HVALS requires key\r\n";
-
+std::string CommandHandler::handleHvals(const std::vector<std::string_view> &args, Database &db) {
     std::vector<std::string> values = db.hvals(args[1]);
     if (values.empty()) {
         return "-Error: Key does not exist or is not a hash\r\n"; // Return error in RESP format
@@ -443,10 +603,7 @@ std::string CommandHandler::handleHvals(const std::vector<std::string> &args, Da
     return response.str();
 }
 
-std::string CommandHandler::handleHlen(const std::vector<std::string> &args, Database &db) {
-    if (args.size() < 2) 
-        return "-Error: HLEN requires key\r\n";
-
+std::string CommandHandler::handleHlen(const std::vector<std::string_view> &args, Database &db) {
     ssize_t len = db.hlen(args[1]);
     if (len < 0) {
         return "-Error: Key does not exist or is not a hash\r\n"; // Return error in RESP format
@@ -455,78 +612,179 @@ std::string CommandHandler::handleHlen(const std::vector<std::string> &args, Dat
 }
 
 
-// Handles the  command and returns the response.
-std::string CommandHandler::handleCommand(const std::vector<std::string>& parsedCommand) {
+// Dispatch table. Arity counts the command name too; a negative arity -N
+// means "at least N". Names must be lowercase. Flags: denyOom, write.
+static constexpr CommandHandler::Command COMMANDS[] = {
+    {"ping", &CommandHandler::handlePing, -1},
+    {"echo", &CommandHandler::handleEcho, 2},
+    {"flushall", &CommandHandler::handleFlushAll, -1, false, true},
+    {"set", &CommandHandler::handleSet, 3, true, true},
+    {"get", &CommandHandler::handleGet, 2},
+    {"keys", &CommandHandler::handleKeys, -1},
+    {"scan", &CommandHandler::handleScan, -2},
+    {"type", &CommandHandler::handleType, 2},
+    {"del", &CommandHandler::handleDel, 2, false, true},
+    {"exists", &CommandHandler::handleExists, 2},
+    {"rename", &CommandHandler::handleRename, 3, false, true},
+    {"expire", &CommandHandler::handleExpiry, 3, false, true},
+    {"ttl", &CommandHandler::handleExpiry, 3, false, true},
+    {"pexpireat", &CommandHandler::handlePexpireat, 3, false, true},
+    {"bgrewriteaof", &CommandHandler::handleBgrewriteaof, 1},
+    {"bgsave", &CommandHandler::handleBgsave, 1},
+    {"lastsave", &CommandHandler::handleLastsave, 1},
+    {"info", &CommandHandler::handleInfo, -1},
+    {"memory", &CommandHandler::handleMemory, -2},
+    {"slowlog", &CommandHandler::handleSlowlog, -2},
+    {"latency", &CommandHandler::handleLatency, -2},
+    {"llen", &CommandHandler::handleLlen, 2},
+    {"lget", &CommandHandler::handleLget, 2},
+    {"lpush", &CommandHandler::handleLpush, -3, true, true},
+    {"rpush", &CommandHandler::handleRpush, -3, true, true},
+    {"lpop", &CommandHandler::handleLpop, 2, false, true},
+    {"rpop", &CommandHandler::handleRpop, 2, false, true},
+    {"lrem", &CommandHandler::handleLrem, 4, false, true},
+    {"lindex", &CommandHandler::handleLindex, 3},
+    {"lset", &CommandHandler::handleLset, 4, true, true},
+    {"hset", &CommandHandler::handleHset, -4, true, true},
+    {"hget", &CommandHandler::handleHget, 3},
+    {"hdel", &CommandHandler::handleHdel, 3, false, true},
+    {"hexists", &CommandHandler::handleHexists, 3},
+    {"hgetall", &CommandHandler::handleHgetall, 2},
+    {"hkeys", &CommandHandler::handleHkeys, 2},
+    {"hvals", &CommandHandler::handleHvals, 2},
+    {"hlen", &CommandHandler::handleHlen, 2},
+    {"hscan", &CommandHandler::handleHscan, -3},
+};
+
+static constexpr size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+static constexpr size_t COMMAND_TABLE_SIZE = 128; // Power of two, kept at least 2x the command count
+
+static_assert(COMMAND_COUNT * 2 <= COMMAND_TABLE_SIZE, "Grow COMMAND_TABLE_SIZE");
+static_assert(COMMAND_COUNT <= Stats::MAX_COMMANDS, "Grow Stats::MAX_COMMANDS");
+
+// Case-insensitive FNV-1a
+static constexpr uint32_t commandHash(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash ^= static_cast<uint8_t>(toLowerAscii(c));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Open-addressing index into COMMANDS, built at compile time. Slots hold the
+// command index + 1, 0 marks an empty slot.
+static constexpr std::array<uint8_t, COMMAND_TABLE_SIZE> buildCommandTable() {
+    std::array<uint8_t, COMMAND_TABLE_SIZE> table{};
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        size_t slot = commandHash(COMMANDS[i].name) & (COMMAND_TABLE_SIZE - 1);
+        while (table[slot] != 0) {
+            slot = (slot + 1) & (COMMAND_TABLE_SIZE - 1);
+        }
+        table[slot] = static_cast<uint8_t>(i + 1);
+    }
+    return table;
+}
+
+static constexpr std::array<uint8_t, COMMAND_TABLE_SIZE> COMMAND_TABLE = buildCommandTable();
+
+// cmdstat_<name>:calls=..,usec=..,usec_per_call=.. for commands that have
+// run, or their latency percentiles for the latencystats section
+static void appendCommandStats(std::string& info, const std::vector<Stats::CommandSummary>& summaries, bool percentiles) {
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        const Stats::CommandSummary& summary = summaries[i];
+        if (summary.calls == 0) {
+            continue;
+        }
+        char line[256];
+        if (percentiles) {
+            snprintf(line, sizeof(line), "latency_percentiles_usec_%.*s:p50=%llu,p99=%llu,p99.9=%llu\r\n",
+                     static_cast<int>(COMMANDS[i].name.size()), COMMANDS[i].name.data(),
+                     static_cast<unsigned long long>(summary.latency.percentile(0.5)),
+                     static_cast<unsigned long long>(summary.latency.percentile(0.99)),
+                     static_cast<unsigned long long>(summary.latency.percentile(0.999)));
+        } else {
+            snprintf(line, sizeof(line), "cmdstat_%.*s:calls=%llu,usec=%llu,usec_per_call=%.2f\r\n",
+                     static_cast<int>(COMMANDS[i].name.size()), COMMANDS[i].name.data(),
+                     static_cast<unsigned long long>(summary.calls),
+                     static_cast<unsigned long long>(summary.micros),
+                     static_cast<double>(summary.micros) / summary.calls);
+        }
+        info += line;
+    }
+}
+
+const CommandHandler::Command* CommandHandler::lookupCommand(std::string_view name) {
+    size_t slot = commandHash(name) & (COMMAND_TABLE_SIZE - 1);
+    while (COMMAND_TABLE[slot] != 0) {
+        const Command& command = COMMANDS[COMMAND_TABLE[slot] - 1];
+        if (equalsIgnoreCase(command.name, name)) {
+            return &command;
+        }
+        slot = (slot + 1) & (COMMAND_TABLE_SIZE - 1);
+    }
+    return nullptr;
+}
+
+// The table entry for a command, or nullptr with the error reply set if it
+// is unknown or has the wrong number of arguments
+static const CommandHandler::Command* resolveCommand(const std::vector<std::string_view>& parsedCommand, std::string& error) {
     if (parsedCommand.empty()) {
-        return "-Error: Empty Command\r\n"; // Return error in RESP format
+        error = "-Error: Empty Command\r\n"; // Return error in RESP format
+        return nullptr;
+    }
+
+    const CommandHandler::Command* command = CommandHandler::lookupCommand(parsedCommand[0]);
+    if (command == nullptr) {
+        error = "-ERR: Unknown command\r\n";
+        return nullptr;
+    }
+
+    // Argument count is checked here once, so handlers can index args directly
+    int argc = static_cast<int>(parsedCommand.size());
+    if ((command->arity > 0 && argc != command->arity) || argc < -command->arity) {
+        error = "-ERR: Wrong number of arguments for '";
+        error += command->name;
+        error += "' command\r\n";
+        return nullptr;
+    }
+    return command;
+}
+
+// Handles the  command and returns the response.
+std::string CommandHandler::handleCommand(const std::vector<std::string_view>& parsedCommand) {
+    std::string error;
+    const Command* command = resolveCommand(parsedCommand, error);
+    if (command == nullptr) {
+        return error;
+    }
+
+    // Writes that could not be logged are refused until the log can be written again
+    if (command->write && !Aof::getInstance().lastWriteOk()) {
+        return "-MISCONF Errors writing to the append only file, write commands are disabled\r\n";
     }
 
-    std::string cmd = parsedCommand[0];
-    std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
     // Connect to DB
     Database& db = Database::getInstance();
-
-    // Handle the command
-    if (cmd == "ping") {
-        return handlePing(parsedCommand, db);
-    } else if (cmd == "echo") {
-        return handleEcho(parsedCommand, db);
-    } else if (cmd == "flushall") {
-        return handleFlushAll(parsedCommand, db);
-    } else if (cmd == "set") {
-        return handleSet(parsedCommand, db);
-    } else if (cmd == "get") {
-        return handleGet(parsedCommand, db);
-    } else if (cmd == "keys") {
-        return handleKeys(parsedCommand, db);
-    } else if (cmd == "type") {
-        return handleType(parsedCommand, db);
-    } else if (cmd == "del") {
-        return handleDel(parsedCommand, db);
-    } else if (cmd == "exists") {
-        return handleExists(parsedCommand, db);
-    } else if (cmd == "rename") {
-        return handleRename(parsedCommand, db);
-    } else if (cmd == "expire" || cmd == "ttl") {
-        return handleExpiry(parsedCommand, db);
-    } else if (cmd == "llen") {
-        return handleLlen(parsedCommand, db);
-    } else if (cmd == "lget") {
-        return handleLget(parsedCommand, db);
-    } else if (cmd == "lpush") {
-        return handleLpush(parsedCommand, db);
-    } else if (cmd == "rpush") {
-        return handleRpush(parsedCommand, db);
-    } else if (cmd == "lpop") {
-        return handleLpop(parsedCommand, db);
-    } else if (cmd == "rpop") {
-        return handleRpop(parsedCommand, db);
-    } else if (cmd == "lrem") {
-        return handleLrem(parsedCommand, db);
-    } else if (cmd == "lindex") {
-        return handleLindex(parsedCommand, db);
-    } else if (cmd == "lset") {
-        return handleLset(parsedCommand, db);
-    } else if (cmd == "hset") {
-        return handleHset(parsedCommand, db);
-    } else if (cmd == "hget") {
-        return handleHget(parsedCommand, db);
-    } else if (cmd == "hdel") {
-        return handleHdel(parsedCommand, db);
-    } else if (cmd == "hexists") {
-        return handleHexists(parsedCommand, db);
-    } else if (cmd == "hgetall") {
-        return handleHgetall(parsedCommand, db);
-    } else if (cmd == "hkeys") {
-        return handleHkeys(parsedCommand, db);
-    } else if (cmd == "hvals") {
-        return handleHvals(parsedCommand, db);
-    } else if (cmd == "hlen") {
-        return handleHlen(parsedCommand, db);
+    if (command->denyOom && !db.freeMemoryIfNeeded()) {
+        return "-OOM command not allowed when used memory > 'maxmemory'\r\n";
     }
-    else {
-        return "-ERR: Unknown command\r\n";
+    auto start = std::chrono::steady_clock::now();
+    std::string reply = (this->*(command->handler))(parsedCommand, db);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    Stats::getInstance().recordCommand(command - COMMANDS, elapsed.count());
+    if (SlowLog::getInstance().isSlow(elapsed.count())) {
+        SlowLog::getInstance().add(parsedCommand, elapsed.count());
     }
+    LatencyMonitor::getInstance().record("command", start);
+    return reply;
 }
 
-
+std::string CommandHandler::replayCommand(const std::vector<std::string_view>& parsedCommand) {
+    std::string error;
+    const Command* command = resolveCommand(parsedCommand, error);
+    if (command == nullptr) {
+        return error;
+    }
+    return (this->*(command->handler))(parsedCommand, Database::getInstance());
+}
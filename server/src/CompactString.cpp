@@ -0,0 +1,51 @@
+#include "../include/CompactString.h"
+#include "../include/Slab.h"
+#include <cstring>
+
+CompactString& CompactString::operator=(const CompactString& other) {
+    if (this != &other) {
+        release();
+        assign(other.view());
+    }
+    return *this;
+}
+
+CompactString& CompactString::operator=(CompactString&& other) noexcept {
+    if (this != &other) {
+        release();
+        bits = other.bits;
+        other.bits = 0;
+    }
+    return *this;
+}
+
+void CompactString::assign(std::string_view value) {
+    if (value.empty()) {
+        bits = 0;
+    } else if (value.size() <= INLINE_CAPACITY) {
+        bits = (value.size() << 1) | 1;
+        std::memcpy(reinterpret_cast<char*>(&bits) + 1, value.data(), value.size());
+    } else {
+        size_t header = varintSize(value.size());
+        char* block = static_cast<char*>(Slab::allocate(header + value.size()));
+        encodeVarint(value.size(), block);
+        std::memcpy(block + header, value.data(), value.size());
+        bits = reinterpret_cast<uintptr_t>(block);
+    }
+}
+
+void CompactString::release() {
+    if (bits != 0 && !isInline()) {
+        std::string_view value = view();
+        Slab::deallocate(reinterpret_cast<char*>(bits), varintSize(value.size()) + value.size());
+    }
+    bits = 0;
+}
+
+size_t CompactString::memoryUsage() const {
+    if (bits == 0 || isInline()) {
+        return 0;
+    }
+    size_t len = view().size();
+    return Slab::allocationSize(varintSize(len) + len);
+}
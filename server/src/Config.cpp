@@ -0,0 +1,199 @@
+#include "../include/Config.h"
+#include "../include/Logger.h"
+#include <cctype>
+#include <sstream>
+#include <string>
+#include <thread>
+
+static bool parseUnsigned(const std::string& value, unsigned int& out) {
+    try {
+        size_t idx = 0;
+        long parsed = std::stol(value, &idx);
+        if (idx != value.size() || parsed < 0) {
+            return false;
+        }
+        out = static_cast<unsigned int>(parsed);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Bytes, with an optional kb/mb/gb suffix (powers of 1024, any case)
+static bool parseMemory(const std::string& value, size_t& out) {
+    size_t digits = 0;
+    while (digits < value.size() && std::isdigit(static_cast<unsigned char>(value[digits]))) {
+        digits++;
+    }
+    if (digits == 0 || digits > 15) {
+        return false;
+    }
+    std::string suffix = value.substr(digits);
+    for (char& c : suffix) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    size_t multiplier;
+    if (suffix.empty() || suffix == "b") {
+        multiplier = 1;
+    } else if (suffix == "kb" || suffix == "k") {
+        multiplier = 1024;
+    } else if (suffix == "mb" || suffix == "m") {
+        multiplier = 1024 * 1024;
+    } else if (suffix == "gb" || suffix == "g") {
+        multiplier = 1024 * 1024 * 1024;
+    } else {
+        return false;
+    }
+    out = std::stoull(value.substr(0, digits)) * multiplier;
+    return true;
+}
+
+// "seconds changes [seconds changes ...]", or "" for no rules
+static bool parseSaveRules(const std::string& value, std::vector<SaveRule>& rules) {
+    std::vector<SaveRule> parsed;
+    std::istringstream iss(value);
+    std::string seconds, changes;
+    while (iss >> seconds) {
+        unsigned int secondsValue, changesValue;
+        if (!(iss >> changes) || !parseUnsigned(seconds, secondsValue) || !parseUnsigned(changes, changesValue)) {
+            return false;
+        }
+        parsed.push_back(SaveRule{secondsValue, changesValue});
+    }
+    rules = std::move(parsed);
+    return true;
+}
+
+bool parseConfig(int argc, char* argv[], Config& config) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg.rfind("--", 0) != 0) {
+            // Positional port, kept for backwards compatibility
+            try {
+                config.port = std::stoi(arg);
+            } catch (const std::exception&) {
+                LOG_ERROR("Invalid port: " << arg);
+                return false;
+            }
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            LOG_ERROR("Missing value for option " << arg);
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if (arg == "--port") {
+            unsigned int port;
+            if (!parseUnsigned(value, port) || port > 65535) {
+                LOG_ERROR("Invalid port: " << value);
+                return false;
+            }
+            config.port = static_cast<int>(port);
+        } else if (arg == "--threads") {
+            if (!parseUnsigned(value, config.threads)) {
+                LOG_ERROR("Invalid thread count: " << value);
+                return false;
+            }
+        } else if (arg == "--hash-max-packed-entries") {
+            if (!parseUnsigned(value, config.hashMaxPackedEntries)) {
+                LOG_ERROR("Invalid hash entry limit: " << value);
+                return false;
+            }
+        } else if (arg == "--hash-max-packed-value") {
+            if (!parseUnsigned(value, config.hashMaxPackedValue)) {
+                LOG_ERROR("Invalid hash value limit: " << value);
+                return false;
+            }
+        } else if (arg == "--maxmemory") {
+            if (!parseMemory(value, config.maxMemory)) {
+                LOG_ERROR("Invalid memory limit (bytes, or with a kb/mb/gb suffix): " << value);
+                return false;
+            }
+        } else if (arg == "--maxmemory-policy") {
+            if (value == "noeviction") {
+                config.maxMemoryPolicy = EvictionPolicy::NoEviction;
+            } else if (value == "allkeys-lru") {
+                config.maxMemoryPolicy = EvictionPolicy::AllKeysLru;
+            } else if (value == "allkeys-lfu") {
+                config.maxMemoryPolicy = EvictionPolicy::AllKeysLfu;
+            } else if (value == "volatile-ttl") {
+                config.maxMemoryPolicy = EvictionPolicy::VolatileTtl;
+            } else {
+                LOG_ERROR("Invalid value for --maxmemory-policy (noeviction|allkeys-lru|allkeys-lfu|volatile-ttl): " << value);
+                return false;
+            }
+        } else if (arg == "--save") {
+            if (!parseSaveRules(value, config.saveRules)) {
+                LOG_ERROR("Invalid save rules (\"seconds changes ...\"): " << value);
+                return false;
+            }
+        } else if (arg == "--appendonly") {
+            if (value != "yes" && value != "no") {
+                LOG_ERROR("Invalid value for --appendonly (yes|no): " << value);
+                return false;
+            }
+            config.appendOnly = value == "yes";
+        } else if (arg == "--appendfilename") {
+            config.appendFilename = value;
+        } else if (arg == "--appendfsync") {
+            if (value == "always") {
+                config.appendFsync = FsyncPolicy::Always;
+            } else if (value == "everysec") {
+                config.appendFsync = FsyncPolicy::EverySec;
+            } else if (value == "no") {
+                config.appendFsync = FsyncPolicy::No;
+            } else {
+                LOG_ERROR("Invalid value for --appendfsync (always|everysec|no): " << value);
+                return false;
+            }
+        } else if (arg == "--io-backend") {
+            if (value == "epoll") {
+                config.ioBackend = IoBackend::Epoll;
+            } else if (value == "io_uring") {
+                config.ioBackend = IoBackend::IoUring;
+            } else {
+                LOG_ERROR("Invalid value for --io-backend (epoll|io_uring): " << value);
+                return false;
+            }
+        } else if (arg == "--slowlog-log-slower-than") {
+            unsigned int micros;
+            if (value == "-1") {
+                config.slowlogLogSlowerThan = -1;
+            } else if (parseUnsigned(value, micros)) {
+                config.slowlogLogSlowerThan = micros;
+            } else {
+                LOG_ERROR("Invalid value for --slowlog-log-slower-than (microseconds, or -1 to disable): " << value);
+                return false;
+            }
+        } else if (arg == "--slowlog-max-len") {
+            if (!parseUnsigned(value, config.slowlogMaxLen)) {
+                LOG_ERROR("Invalid value for --slowlog-max-len: " << value);
+                return false;
+            }
+        } else if (arg == "--latency-monitor-threshold") {
+            if (!parseUnsigned(value, config.latencyMonitorThreshold)) {
+                LOG_ERROR("Invalid value for --latency-monitor-threshold (milliseconds): " << value);
+                return false;
+            }
+        } else if (arg == "--loglevel") {
+            if (!Logger::parseLevel(value, config.logLevel)) {
+                LOG_ERROR("Invalid value for --loglevel (debug|info|warning|error): " << value);
+                return false;
+            }
+        } else {
+            LOG_ERROR("Unknown option: " << arg);
+            return false;
+        }
+    }
+
+    if (config.threads == 0) {
+        config.threads = std::thread::hardware_concurrency();
+        if (config.threads == 0) {
+            config.threads = 1;
+        }
+    }
+    return true;
+}
@@ -1,77 +1,528 @@
 #include "../include/Database.h"
+#include "../include/Snapshot.h"
+#include "../include/Aof.h"
+#include "../include/Logger.h"
+#include "../include/Glob.h"
+#include "../include/LatencyMonitor.h"
 #include <mutex>
 #include <fstream>
 #include <sstream>
-#include <string> 
+#include <string>
 #include <vector>
 #include <mutex>
 #include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <optional>
+#include <cstdint>
+#include <cerrno>
+#include <random>
+#include <fcntl.h>
+#include <unistd.h>
 
 Database& Database::getInstance() {
     static Database instance;
     return instance;
 }
 
-/*
-We will handle three types of data:
-1. Key-Value pairs
-2. Lists
-3. Hashes
+// Takes the shard from the high half of the hash: each shard's Dict indexes
+// its buckets with the low bits, which would otherwise be equal in a shard
+Database::Shard& Database::shardFor(std::string_view key) {
+    return shards[(StringHash{}(key) >> 32) % SHARD_COUNT];
+}
 
-Format for dumping and loading the database:
-K key value
-L key item1 item2 item3 ...
-H key field1 value1 field2 value2 ...
-*/
+// Keys do not expire while the append only file is replayed: an expiry that
+// happened before the restart is in the log as a DEL, and an expired key the
+// log writes to again was still live when it was written
+bool Database::isExpired(const Object& object) const {
+    return object.hasExpiry() && object.expiresAt <= std::chrono::steady_clock::now() &&
+           !loading.load(std::memory_order_relaxed);
+}
+
+// Approximate bytes a key costs: its map node (next pointer, cached hash, the
+// key string and the Object), its share of the bucket array, and whatever the
+// key and value hold on the heap
+static size_t entryMemory(const CompactString& key, const Object& object) {
+    return 3 * sizeof(void*) + sizeof(CompactString) + key.memoryUsage() + object.memoryUsage();
+}
+
+// Finds key, deleting it first if its TTL has passed, and records the access
+Object* Database::lookup(Shard& shard, std::string_view key) {
+    auto it = shard.keyspace.find(key);
+    if (it == shard.keyspace.end()) {
+        return nullptr;
+    }
+    Object& object = it->second;
+    if (isExpired(object)) {
+        expireKey(shard, it);
+        return nullptr;
+    }
+    object.touch();
+    return &object;
+}
+
+// Value of key if it exists and holds a T
+template <typename T>
+T* Database::lookupAs(Shard& shard, std::string_view key) {
+    Object* object = lookup(shard, key);
+    return object != nullptr ? std::get_if<T>(&object->value) : nullptr;
+}
+
+// Like lookupAs, but creates an empty T when key is missing. Returns nullptr
+// only when key holds another type.
+template <typename T>
+T* Database::lookupOrCreate(Shard& shard, std::string_view key) {
+    if (Object* object = lookup(shard, key)) {
+        return std::get_if<T>(&object->value);
+    }
+    KeyEntry& entry = *shard.keyspace.emplace(CompactString(key), Object()).first;
+    entry.second.touch();
+    T* value = &entry.second.value.emplace<T>();
+    chargeMemory(shard, 0, entryMemory(entry.first, entry.second));
+    return value;
+}
+
+// Records a write: counts it towards the save rules and logs its effect.
+// Called with the shard lock held, so the log sees writes to a key in the
+// order they were applied.
+void Database::propagate(Shard& shard, std::initializer_list<std::string_view> args) {
+    shard.dirty.fetch_add(1, std::memory_order_relaxed);
+    Aof::getInstance().append(args);
+}
+
+void Database::propagate(Shard& shard, const std::vector<std::string_view>& args) {
+    shard.dirty.fetch_add(1, std::memory_order_relaxed);
+    Aof::getInstance().append(args);
+}
+
+// Deletes a key whose TTL has passed. Logged as a DEL, as the log has no
+// other record of it and a replay would apply the old TTL to whatever is
+// written to the key next.
+void Database::expireKey(Shard& shard, Keyspace::iterator it) {
+    propagate(shard, {"DEL", it->first.view()});
+    removeKey(shard, it);
+}
+
+// Adds the growth (or takes off the shrinkage) of a key from before to after.
+// The counter is unsigned, so a shrink wraps around to the right value.
+void Database::chargeMemory(Shard& shard, size_t before, size_t after) {
+    shard.usedMemory.fetch_add(after - before, std::memory_order_relaxed);
+}
+
+uint64_t Database::dirtyCount() {
+    uint64_t total = 0;
+    for (const auto& shard : shards) {
+        total += shard.dirty.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Database::keyspaceCounts(size_t& keys, size_t& expires) {
+    keys = 0;
+    expires = 0;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        keys += shard.keyspace.size();
+        expires += shard.expiryHeap.size();
+    }
+}
+
+// TTLs live on the steady clock in memory and as Unix milliseconds on disk
+static uint64_t toUnixMillis(std::chrono::steady_clock::time_point when) {
+    auto remaining = when - std::chrono::steady_clock::now();
+    auto absolute = std::chrono::system_clock::now().time_since_epoch() +
+                    std::chrono::duration_cast<std::chrono::system_clock::duration>(remaining);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(absolute).count();
+}
+
+static std::chrono::steady_clock::time_point fromUnixMillis(uint64_t millis) {
+    auto remaining = std::chrono::milliseconds(millis) - std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(remaining);
+}
 
 bool Database::dumpDatabase(const std::string& filename) {
-    // Implement the logic to dump the database to a file
-    std::cout << "Dumping database to " << filename << std::endl;
-    std::lock_guard<std::mutex> lock(db_mutex);
-    std::ofstream ofs(filename, std::ios::binary);
-    if (!ofs) {
-        std::cerr << "Error opening file for writing: " << filename << std::endl;
+    LOG_INFO("Dumping database to " << filename);
+    if (!writeSnapshot(filename, true)) {
+        LOG_ERROR("Error writing database to " << filename);
         return false;
     }
+    return true;
+}
+
+pid_t Database::forkSnapshot(const std::string& filename) {
+    return forkConsistent([this, filename] () {
+        return writeSnapshot(filename, false);
+    });
+}
+
+pid_t Database::forkConsistent(const std::function<bool()>& childMain, const std::function<void(pid_t)>& onForked) {
+    // Hold every shard lock across fork() so no thread is halfway through a
+    // mutation; the child then sees a consistent dataset and the parent
+    // releases the locks as soon as fork returns
+    auto start = std::chrono::steady_clock::now();
+    for (auto& shard : shards) {
+        shard.mutex.lock();
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Child: only this thread exists and the locks are held on its behalf,
+        // so work without locking and leave without running any destructors
+        Logger::getInstance().forked();
+        _exit(childMain() ? 0 : 1);
+    }
+    if (onForked) {
+        onForked(pid);
+    }
+    for (auto& shard : shards) {
+        shard.mutex.unlock();
+    }
+    LatencyMonitor::getInstance().record("fork", start);
+    return pid;
+}
 
-    for (const auto& kv : keyValueStore) {
-        ofs << "K " <<  kv.first << " " << kv.second << "\n";
+// Writes the dataset as the shortest command sequence that rebuilds it. Only
+// runs in a child forked by forkConsistent, so it reads without locking.
+bool Database::writeCommandLog(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
     }
 
-    for (const auto& list : listStore) {
-        ofs << "L " << list.first << " ";
-        for (const auto& item : list.second) {
-            ofs << item << " ";
+    static constexpr size_t ITEMS_PER_COMMAND = 64; // Long lists and hashes are split up
+    static constexpr size_t FLUSH_SIZE = 1 << 20;
+    std::string buffer;
+    std::vector<std::string_view> args;
+    bool ok = true;
+
+    auto flushBuffer = [&] () {
+        const char* data = buffer.data();
+        size_t len = buffer.size();
+        while (ok && len > 0) {
+            ssize_t written = ::write(fd, data, len);
+            if (written < 0 && errno != EINTR) {
+                ok = false;
+            } else if (written > 0) {
+                data += written;
+                len -= written;
+            }
+        }
+        buffer.clear();
+    };
+    auto emit = [&] () {
+        Aof::encodeCommand(buffer, args);
+        if (buffer.size() >= FLUSH_SIZE) {
+            flushBuffer();
+        }
+    };
+
+    for (auto& shard : shards) {
+        for (const auto& [key, object] : shard.keyspace) {
+            switch (object.type()) {
+                case ObjectType::String:
+                    args = {"SET", key, std::get<CompactString>(object.value)};
+                    emit();
+                    break;
+                case ObjectType::List:
+                    args = {"RPUSH", key};
+                    std::get<QuickList>(object.value).forEach([&] (std::string_view item) {
+                        args.push_back(item);
+                        if (args.size() == 2 + ITEMS_PER_COMMAND) {
+                            emit();
+                            args.resize(2);
+                        }
+                    });
+                    if (args.size() > 2) {
+                        emit();
+                    }
+                    break;
+                case ObjectType::Hash:
+                    args = {"HSET", key};
+                    std::get<Hash>(object.value).forEach([&] (std::string_view field, std::string_view value) {
+                        args.push_back(field);
+                        args.push_back(value);
+                        if (args.size() == 2 + 2 * ITEMS_PER_COMMAND) {
+                            emit();
+                            args.resize(2);
+                        }
+                    });
+                    if (args.size() > 2) {
+                        emit();
+                    }
+                    break;
+            }
+            if (object.hasExpiry()) {
+                std::string when = std::to_string(toUnixMillis(object.expiresAt));
+                args = {"PEXPIREAT", key, when};
+                emit();
+            }
         }
-        ofs << "\n";
     }
+    flushBuffer();
 
-    for (const auto& hash : hashStore) {
-        ofs << "H " << hash.first << " ";
-        for (const auto& field : hash.second) {
-            ofs << field.first << " " << field.second << " ";
-        } 
-        ofs << "\n";
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+// Writes the binary format described in Snapshot.h. Must not log: it also
+// runs in the forked child, where other threads' locks may be held.
+bool Database::writeSnapshot(const std::string& filename, bool lockShards) {
+    SnapshotWriter writer(filename, SHARD_COUNT);
+
+    if (!writer.isOpen()) {
+        return false;
     }
 
-    return true;
+    // Only one shard is locked at a time, so writers to other shards keep going
+    for (auto& shard : shards) {
+        std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+        if (lockShards) {
+            lock.lock();
+        }
+
+        writer.beginSection(); // One section per shard
+        for (const auto& [key, object] : shard.keyspace) {
+            writer.writeByte(static_cast<uint8_t>(object.type()));
+            writer.writeByte(object.hasExpiry() ? SNAPSHOT_HAS_EXPIRY : 0);
+            if (object.hasExpiry()) {
+                writer.writeFixed64(toUnixMillis(object.expiresAt));
+            }
+            writer.writeString(key);
+
+            switch (object.type()) {
+                case ObjectType::String:
+                    writer.writeString(std::get<CompactString>(object.value));
+                    break;
+                case ObjectType::List: {
+                    const QuickList& list = std::get<QuickList>(object.value);
+                    writer.writeVarint(list.size());
+                    list.forEach([&writer](std::string_view item) {
+                        writer.writeString(item);
+                    });
+                    break;
+                }
+                case ObjectType::Hash: {
+                    const Hash& hash = std::get<Hash>(object.value);
+                    writer.writeVarint(hash.size());
+                    hash.forEach([&writer](std::string_view field, std::string_view value) {
+                        writer.writeString(field);
+                        writer.writeString(value);
+                    });
+                    break;
+                }
+            }
+        }
+        writer.endSection(shard.keyspace.size());
+    }
+
+    return writer.finish();
+}
+
+// Decodes the record after its type byte. False on a truncated or unknown record.
+static bool readRecord(SnapshotReader& reader, uint8_t type, std::string_view& key, Object& object) {
+    uint8_t flags;
+    uint64_t expiresAt = 0;
+    if (!reader.readByte(flags) ||
+        ((flags & SNAPSHOT_HAS_EXPIRY) && !reader.readFixed64(expiresAt)) ||
+        !reader.readString(key)) {
+        return false;
+    }
+
+    bool ok = true;
+    if (type == static_cast<uint8_t>(ObjectType::String)) {
+        std::string_view value;
+        ok = reader.readString(value);
+        object.value.emplace<CompactString>(value);
+    } else if (type == static_cast<uint8_t>(ObjectType::List)) {
+        QuickList& list = object.value.emplace<QuickList>();
+        uint64_t count;
+        ok = reader.readVarint(count);
+        std::string_view item;
+        for (uint64_t i = 0; ok && i < count; i++) {
+            if ((ok = reader.readString(item))) {
+                list.pushBack(item);
+            }
+        }
+    } else if (type == static_cast<uint8_t>(ObjectType::Hash)) {
+        Hash& hash = object.value.emplace<Hash>();
+        uint64_t count;
+        ok = reader.readVarint(count);
+        std::string_view field, value;
+        for (uint64_t i = 0; ok && i < count; i++) {
+            if ((ok = reader.readString(field) && reader.readString(value))) {
+                hash.set(field, value);
+            }
+        }
+    } else {
+        ok = false;
+    }
+
+    if (ok && (flags & SNAPSHOT_HAS_EXPIRY)) {
+        object.expiresAt = fromUnixMillis(expiresAt);
+    }
+    return ok;
 }
 
 bool Database::loadDatabase(const std::string& filename) {
-    // Implement the logic to load the database from a file
-    std::cout << "Loading database from " << filename << std::endl;
-    
-    std::lock_guard<std::mutex> lock(db_mutex);
+    LOG_INFO("Loading database from " << filename);
+
+    SnapshotReader reader;
+    if (!reader.open(filename)) {
+        LOG_ERROR("Error opening file for reading: " << filename);
+        return false;
+    }
+    if (!reader.hasMagic()) {
+        return loadLegacyDatabase(filename); // Text dump from an older version
+    }
+
+    uint8_t version;
+    if (!reader.readHeader(version) || (version != SNAPSHOT_VERSION && version != SNAPSHOT_VERSION_SINGLE)) {
+        LOG_ERROR("Unsupported snapshot version in " << filename);
+        return false;
+    }
+
+    if (version == SNAPSHOT_VERSION_SINGLE) {
+        if (!reader.verifyChecksum()) {
+            LOG_ERROR("Checksum mismatch in " << filename << ", not loading it");
+            return false;
+        }
+        flushAll();
+        if (!loadRecords(reader, std::nullopt)) {
+            LOG_ERROR("Corrupt snapshot record in " << filename);
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<SnapshotSection> sections;
+    if (!reader.readSections(sections)) {
+        LOG_ERROR("Corrupt section table in " << filename << ", not loading it");
+        return false;
+    }
+
+    // Runs fn over every section on a pool of threads that claim sections in
+    // turn; the calling thread is one of them. False if fn failed for any section.
+    auto forEachSection = [&sections](const std::function<bool(const SnapshotSection&)>& fn) {
+        size_t workerCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), sections.size());
+        std::atomic<size_t> nextSection{0};
+        std::atomic<bool> failed{false};
+        auto work = [&]() {
+            size_t index;
+            while (!failed.load(std::memory_order_relaxed) &&
+                   (index = nextSection.fetch_add(1, std::memory_order_relaxed)) < sections.size()) {
+                if (!fn(sections[index])) {
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < workerCount; i++) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        return !failed.load();
+    };
+
+    // Every checksum is checked before anything is replaced, as with version 1
+    if (!forEachSection([&reader](const SnapshotSection& section) { return reader.verifySection(section); })) {
+        LOG_ERROR("Checksum mismatch in " << filename << ", not loading it");
+        return false;
+    }
+
+    flushAll();
+
+    // Size every shard's table for its share of the keys up front, with some
+    // slack for uneven hashing, so the decoders never trigger a rehash
+    uint64_t totalKeys = 0;
+    for (const SnapshotSection& section : sections) {
+        totalKeys += section.keys;
+    }
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.keyspace.reserve(totalKeys / SHARD_COUNT + totalKeys / SHARD_COUNT / 8 + 1);
+    }
+
+    bool loaded = forEachSection([this, &reader](const SnapshotSection& section) {
+        SnapshotReader sectionReader = reader.section(section);
+        return loadRecords(sectionReader, section.keys);
+    });
+    if (!loaded) {
+        LOG_ERROR("Corrupt snapshot record in " << filename);
+        return false;
+    }
+    return true;
+}
+
+// Decodes `count` records, or up to SNAPSHOT_EOF without one (version 1). Keys are handed to their shards in batches, so concurrent
+// loaders take each shard lock once per batch rather than once per key.
+bool Database::loadRecords(SnapshotReader& reader, std::optional<uint64_t> count) {
+    std::array<std::vector<std::pair<CompactString, Object>>, SHARD_COUNT> pending;
+    auto flushPending = [this, &pending](size_t index) {
+        Shard& shard = shards[index];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& [key, object] : pending[index]) {
+            insertRestored(shard, std::move(key), std::move(object));
+        }
+        pending[index].clear();
+    };
+
+    auto now = std::chrono::steady_clock::now();
+    bool ok = true;
+    for (uint64_t read = 0; !count || read < *count; read++) {
+        uint8_t type;
+        if (!reader.readByte(type)) {
+            ok = false;
+            break;
+        }
+        if (!count && type == SNAPSHOT_EOF) {
+            break;
+        }
+
+        std::string_view key;
+        Object object;
+        if (!readRecord(reader, type, key, object)) {
+            ok = false;
+            break;
+        }
+        if (object.hasExpiry() && object.expiresAt <= now) {
+            continue; // Expired while the server was down
+        }
+        object.touch();
+
+        size_t index = &shardFor(key) - shards.data();
+        pending[index].emplace_back(CompactString(key), std::move(object));
+        if (pending[index].size() >= RESTORE_BATCH) {
+            flushPending(index);
+        }
+    }
+
+    for (size_t index = 0; index < SHARD_COUNT; index++) {
+        if (!pending[index].empty()) {
+            flushPending(index);
+        }
+    }
+    return ok && (!count || reader.remaining() == 0);
+}
+
+/*
+Legacy text format, still accepted by loadDatabase:
+K key value
+L key item1 item2 item3 ...
+H key field1 value1 field2 value2 ...
+*/
+bool Database::loadLegacyDatabase(const std::string& filename) {
     std::ifstream ifs(filename, std::ios::binary);
 
     if (!ifs) {
-        std::cerr << "Error opening file for reading: " << filename << std::endl;
+        LOG_ERROR("Error opening file for reading: " << filename);
         return false;
     }
 
-    keyValueStore.clear();
-    listStore.clear();
-    hashStore.clear();
+    flushAll();
 
     std::string line;
     while (std::getline(ifs, line)) {
@@ -82,301 +533,419 @@ bool Database::loadDatabase(const std::string& filename) {
         if (type == "K") {
             std::string key, value;
             iss >> key >> value;
-            keyValueStore[key] = value;
+            restoreKey(CompactString(key), Object(value));
         } else if (type == "L") {
             std::string key;
             iss >> key;
-            std::vector<std::string> listItems;
+            Object object;
+            QuickList& listItems = object.value.emplace<QuickList>();
             std::string item;
             while (iss >> item) {
-                listItems.push_back(item);
+                listItems.pushBack(item);
             }
-            listStore[key] = listItems;
+            restoreKey(CompactString(key), std::move(object));
         } else if (type == "H") {
             std::string key, field, value;
             iss >> key;
+            Object object;
+            Hash& hash = object.value.emplace<Hash>();
             while (iss >> field >> value) {
-                hashStore[key][field] = value;
+                hash.set(field, value);
             }
+            restoreKey(CompactString(key), std::move(object));
         }
     }
 
     return true;
 }
 
+void Database::restoreKey(CompactString key, Object object) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    insertRestored(shard, std::move(key), std::move(object));
+}
+
+void Database::insertRestored(Shard& shard, CompactString key, Object object) {
+    if (auto it = shard.keyspace.find(key); it != shard.keyspace.end()) {
+        removeKey(shard, it);
+    }
+    object.heapIndex = Object::NOT_IN_HEAP;
+    KeyEntry& entry = *shard.keyspace.emplace(std::move(key), std::move(object)).first;
+    chargeMemory(shard, 0, entryMemory(entry.first, entry.second));
+    if (entry.second.hasExpiry()) {
+        heapPush(shard, entry);
+    }
+}
+
 // FLUSHALL
 bool Database::flushAll() {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    keyValueStore.clear();
-    listStore.clear();
-    hashStore.clear();
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.dirty.fetch_add(shard.keyspace.size(), std::memory_order_relaxed);
+        shard.expiryHeap.clear();
+        shard.keyspace.clear();
+        shard.usedMemory.store(0, std::memory_order_relaxed);
+    }
+    Aof::getInstance().append({"FLUSHALL"});
     return true;
 }
 
 // Key Value Store Operations
-bool Database::set(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    purgeExpired();
-    keyValueStore[key] = value;
+bool Database::set(std::string_view key, std::string_view value) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (Object* object = lookup(shard, key)) {
+        size_t before = object->memoryUsage();
+        object->value.emplace<CompactString>(value); // Replaces a value of any type, keeps the TTL
+        chargeMemory(shard, before, object->memoryUsage());
+    } else {
+        KeyEntry& entry = *shard.keyspace.emplace(CompactString(key), Object(value)).first;
+        chargeMemory(shard, 0, entryMemory(entry.first, entry.second));
+    }
+    propagate(shard, {"SET", key, value});
     return true;
 }
 
-std::string Database::get(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    purgeExpired();
-    auto it = keyValueStore.find(key);
-    if (it != keyValueStore.end()) {
-        return it->second;
+std::string Database::get(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (CompactString* value = lookupAs<CompactString>(shard, key)) {
+        return std::string(value->view());
     }
     return ""; // Return empty string if key does not exist
 }
 
-std::vector<std::string> Database::keys() {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    purgeExpired();
+std::vector<std::string> Database::keys(std::string_view pattern) {
     std::vector<std::string> keysList;
-    for (const auto& kv : keyValueStore) {
-        keysList.push_back(kv.first);
+    bool matchAll = pattern == "*";
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        purgeExpired(shard, SIZE_MAX);
+        for (const auto& entry : shard.keyspace) {
+            if (matchAll || globMatch(pattern, entry.first)) {
+                keysList.emplace_back(entry.first.view());
+            }
+        }
     }
     return keysList;
 }
 
-std::string Database::type(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    purgeExpired();
-    if (keyValueStore.find(key) != keyValueStore.end()) {
-        return "string";
-    } else if (listStore.find(key) != listStore.end()) {
-        return "list";
-    } else if (hashStore.find(key) != hashStore.end()) {
-        return "hash";
+// Cursor: shard in the top bits, that shard's Dict::scan cursor below them
+uint64_t Database::scan(uint64_t cursor, size_t count, std::string_view pattern, std::vector<std::string>& keys) {
+    static_assert(SHARD_COUNT == size_t(1) << (64 - SCAN_SHARD_SHIFT), "SCAN cursors hold the shard in the top bits");
+    size_t index = cursor >> SCAN_SHARD_SHIFT;
+    uint64_t position = cursor & ((uint64_t(1) << SCAN_SHARD_SHIFT) - 1);
+    bool matchAll = pattern == "*";
+    auto now = std::chrono::steady_clock::now();
+    size_t visited = 0;
+
+    while (index < SHARD_COUNT && visited < count) {
+        Shard& shard = shards[index];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        position = shard.keyspace.scan(position, count - visited, [&](const KeyEntry& entry) {
+            visited++;
+            if (entry.second.hasExpiry() && entry.second.expiresAt <= now) {
+                return;
+            }
+            if (matchAll || globMatch(pattern, entry.first)) {
+                keys.emplace_back(entry.first.view());
+            }
+        });
+        if (position != 0) {
+            return (uint64_t(index) << SCAN_SHARD_SHIFT) | position; // Stopped inside this shard
+        }
+        index++;
+    }
+    return index < SHARD_COUNT ? uint64_t(index) << SCAN_SHARD_SHIFT : 0;
+}
+
+std::string Database::type(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (Object* object = lookup(shard, key)) {
+        switch (object->type()) {
+            case ObjectType::String: return "string";
+            case ObjectType::List: return "list";
+            case ObjectType::Hash: return "hash";
+        }
     }
     return "none"; // Return "none" if key does not exist
 }
 
-bool Database::del(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    purgeExpired();
-    if (keyValueStore.erase(key) > 0) {
-        if (expiryStore.find(key) != expiryStore.end()) {
-            expiryStore.erase(key); // Remove from expiry store if it exists
-        }
-        return true; // Key was found and deleted
-    } else if (listStore.erase(key) > 0) {
-        if (expiryStore.find(key) != expiryStore.end()) {
-            expiryStore.erase(key); // Remove from expiry store if it exists
-        }
-        return true; // Key was found and deleted
-    } else if (hashStore.erase(key) > 0) {
-        if (expiryStore.find(key) != expiryStore.end()) {
-            expiryStore.erase(key); // Remove from expiry store if it exists
-        }
-        return true; // Key was found and deleted
+bool Database::del(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.keyspace.find(key);
+    if (it == shard.keyspace.end()) {
+        return false; // Key does not exist
+    }
+    if (isExpired(it->second)) {
+        expireKey(shard, it);
+        return false;
     }
-    return false; // Key does not exist
+    propagate(shard, {"DEL", key});
+    removeKey(shard, it);
+    return true; // Key was found and deleted
+}
+
+bool Database::exists(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return lookup(shard, key) != nullptr;
 }
 
-bool Database::exists(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    purgeExpired();
-    if (keyValueStore.find(key) != keyValueStore.end() || listStore.find(key) != listStore.end() || hashStore.find(key) != hashStore.end()) {
+bool Database::rename(std::string_view oldKey, std::string_view newKey) {
+    Shard& oldShard = shardFor(oldKey);
+    Shard& newShard = shardFor(newKey);
+
+    // Lock both shards (deadlock free), or just the one if they are the same
+    std::unique_lock<std::mutex> oldLock(oldShard.mutex, std::defer_lock);
+    std::unique_lock<std::mutex> newLock(newShard.mutex, std::defer_lock);
+    if (&oldShard == &newShard) {
+        oldLock.lock();
+    } else {
+        std::lock(oldLock, newLock);
+    }
+
+    if (lookup(oldShard, oldKey) == nullptr) {
+        return false;
+    }
+    if (oldKey == newKey) {
         return true;
     }
-    return false;
+    propagate(oldShard, {"RENAME", oldKey, newKey});
+
+    auto oldIt = oldShard.keyspace.find(oldKey);
+    size_t oldMemory = entryMemory(oldIt->first, oldIt->second);
+    Object object = std::move(oldIt->second);
+    chargeMemory(oldShard, oldMemory, entryMemory(oldIt->first, oldIt->second)); // Down to the moved-from husk, which removeKey takes off
+    removeKey(oldShard, oldIt); // Moving copies heapIndex, so this still finds the heap slot
+    object.heapIndex = Object::NOT_IN_HEAP;
+
+    if (auto it = newShard.keyspace.find(newKey); it != newShard.keyspace.end()) {
+        removeKey(newShard, it);
+    }
+    KeyEntry& entry = *newShard.keyspace.emplace(CompactString(newKey), std::move(object)).first;
+    chargeMemory(newShard, 0, entryMemory(entry.first, entry.second));
+    if (entry.second.hasExpiry()) {
+        heapPush(newShard, entry);
+    }
+    return true;
 }
 
-bool Database::rename(const std::string& oldKey, const std::string& newKey) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    purgeExpired();
-    bool found = false;
-    if (keyValueStore.find(oldKey) != keyValueStore.end()) {
-        keyValueStore[newKey] = keyValueStore[oldKey];
-        keyValueStore.erase(oldKey);
-        found = true;
-    } else if (listStore.find(oldKey) != listStore.end()) {
-        listStore[newKey] = listStore[oldKey];
-        listStore.erase(oldKey);
-        found = true;
-    } else if (hashStore.find(oldKey) != hashStore.end()) {
-        hashStore[newKey] = hashStore[oldKey];
-        hashStore.erase(oldKey);
-        found = true;
+bool Database::expiry(std::string_view key, int seconds) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (lookup(shard, key) == nullptr) {
+        return false; // Key does not exist
+    }
+    KeyEntry& entry = *shard.keyspace.find(key);
+    if (seconds <= 0) {
+        // If seconds is 0 or negative, drop the TTL
+        setExpiry(shard, entry, Object::NO_EXPIRY);
+        propagate(shard, {"EXPIRE", key, "0"});
+    }
+    else {
+        // Set the expiry time to now + seconds. Logged as an absolute time so
+        // replaying the log later does not extend the TTL.
+        auto when = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+        setExpiry(shard, entry, when);
+        propagate(shard, {"PEXPIREAT", key, std::to_string(toUnixMillis(when))});
     }
+    return true;
+}
 
-    if (expiryStore.find(oldKey) != expiryStore.end()) {
-        expiryStore[newKey] = expiryStore[oldKey];
-        expiryStore.erase(oldKey);
+bool Database::expireAt(std::string_view key, uint64_t unixMillis) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (lookup(shard, key) == nullptr) {
+        return false; // Key does not exist
     }
-    return found;
+    setExpiry(shard, *shard.keyspace.find(key), fromUnixMillis(unixMillis));
+    propagate(shard, {"PEXPIREAT", key, std::to_string(unixMillis)});
+    return true;
 }
 
-ssize_t Database::llen(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (listStore.find(key) != listStore.end()) {
-        return listStore[key].size();
+ssize_t Database::llen(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (QuickList* list = lookupAs<QuickList>(shard, key)) {
+        return list->size();
     }
     else {
         return -1;
     }
 }
 
-std::string Database::lindex(const std::string& key, int index) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (listStore.find(key) != listStore.end()) {
-        const auto& list = listStore[key];
-        if (index < 0) {
-            index += list.size(); // Handle negative index
-        }
-        if (index >= 0 && index < static_cast<int>(list.size())) {
-            return list[index];
+std::string Database::lindex(std::string_view key, int index) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (QuickList* list = lookupAs<QuickList>(shard, key)) {
+        std::string value;
+        if (list->index(index, value)) { // Negative indexes count from the tail
+            return value;
         }
     }
     return ""; // Return empty string if key does not exist or index is out of range
 }
 
-std::string Database::lpop(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (listStore.find(key) != listStore.end() && !listStore[key].empty()) {
-        std::string value = listStore[key].front(); // Get the first element
-        listStore[key].erase(listStore[key].begin()); // Remove the first element
+std::string Database::lpop(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    QuickList* list = lookupAs<QuickList>(shard, key);
+    if (list != nullptr && !list->empty()) {
+        std::string value;
+        size_t before = list->memoryUsage();
+        list->popFront(value); // Get and remove the first element
+        chargeMemory(shard, before, list->memoryUsage());
+        propagate(shard, {"LPOP", key});
+        if (list->empty()) {
+            removeKey(shard, shard.keyspace.find(key)); // Popping the last element deletes the key
+        }
         return value;
     }
     return ""; // Return empty string if key does not exist or list is empty
 }
 
-std::string Database::rpop(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (listStore.find(key) != listStore.end() && !listStore[key].empty()) {
-        std::string value = listStore[key].back(); // Get the last element
-        listStore[key].pop_back(); // Remove the last element
+std::string Database::rpop(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    QuickList* list = lookupAs<QuickList>(shard, key);
+    if (list != nullptr && !list->empty()) {
+        std::string value;
+        size_t before = list->memoryUsage();
+        list->popBack(value); // Get and remove the last element
+        chargeMemory(shard, before, list->memoryUsage());
+        propagate(shard, {"RPOP", key});
+        if (list->empty()) {
+            removeKey(shard, shard.keyspace.find(key)); // Popping the last element deletes the key
+        }
         return value;
     }
     return ""; // Return empty string if key does not exist or list is empty
 }
 
-bool Database::lset(const std::string& key, int index, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (listStore.find(key) != listStore.end()) {
-        std::vector<std::string>& list = listStore[key]; // Use reference to modify in place
-        if (index < 0) {
-            index = static_cast<int>(list.size()) + index; // Support negative indexing
-        }
-        if (index < 0 || index >= static_cast<int>(list.size())) {
+bool Database::lset(std::string_view key, int index, std::string_view value) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (QuickList* list = lookupAs<QuickList>(shard, key)) {
+        size_t before = list->memoryUsage();
+        if (!list->set(index, value)) { // Supports negative indexing
             return false;
         }
-        list[index] = value;
+        chargeMemory(shard, before, list->memoryUsage());
+        propagate(shard, {"LSET", key, std::to_string(index), value});
         return true;
     }
     return false; // Key not found
 }
 
-void Database::lpush(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    listStore[key].insert(listStore[key].begin(), value);
+bool Database::lpush(std::string_view key, std::string_view value) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    QuickList* list = lookupOrCreate<QuickList>(shard, key);
+    if (list == nullptr) {
+        return false;
+    }
+    size_t before = list->memoryUsage();
+    list->pushFront(value);
+    chargeMemory(shard, before, list->memoryUsage());
+    propagate(shard, {"LPUSH", key, value});
+    return true;
 }
 
-void Database::rpush(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    listStore[key].push_back(value);
+bool Database::rpush(std::string_view key, std::string_view value) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    QuickList* list = lookupOrCreate<QuickList>(shard, key);
+    if (list == nullptr) {
+        return false;
+    }
+    size_t before = list->memoryUsage();
+    list->pushBack(value);
+    chargeMemory(shard, before, list->memoryUsage());
+    propagate(shard, {"RPUSH", key, value});
+    return true;
 }
 
-int Database::lrem(const std::string& key, int count, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
+int Database::lrem(std::string_view key, int count, std::string_view value) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
     int removedCount = 0;
-    if (listStore.find(key) != listStore.end()) {
-        std::vector<std::string> list = listStore[key];
-        if (count == 0) {
-            for (auto it = list.begin(); it != list.end();) {
-                if (*it == value) {
-                    it = list.erase(it); // Remove the item and get the next iterator
-                    removedCount++;
-                } else {
-                    ++it;
-                }
-            }
-        }
-        else if (count < 0) {
-            for (auto it = list.rbegin(); it != list.rend() && removedCount < -count;) {
-                if (*it == value) {
-                    auto normalIt = it.base();
-                    --normalIt;
-                    normalIt = list.erase(normalIt); // Remove the item and get the next iterator
-                    it = std::vector<std::string>::reverse_iterator(normalIt); // Update reverse iterator
-                    removedCount++;
-                } else {
-                    ++it;
-                }
-            }
-        } else {
-            for (auto it = list.begin(); it != list.end() && removedCount < count;) {
-                if (*it == value) {
-                    it = list.erase(it); // Remove the item and get the next iterator
-                    removedCount++;
-                } else {
-                    ++it;
-                }
-            }
+    if (QuickList* list = lookupAs<QuickList>(shard, key)) {
+        size_t before = list->memoryUsage();
+        removedCount = static_cast<int>(list->remove(count, value));
+        chargeMemory(shard, before, list->memoryUsage());
+        if (removedCount > 0) {
+            propagate(shard, {"LREM", key, std::to_string(count), value});
         }
 
-        if (list.empty()) {
-            listStore.erase(key); // Remove the key if the list is empty
-        } else {
-            listStore[key] = list; // Update the list in the store
+        if (list->empty()) {
+            removeKey(shard, shard.keyspace.find(key)); // Remove the key if the list is empty
         }
     }
 
     return removedCount; // Return the number of removed items
 }
 
-std::vector<std::string> Database::lget(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (listStore.find(key) != listStore.end()) {
-        return listStore[key]; // Return the list if it exists
+std::vector<std::string> Database::lget(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (QuickList* list = lookupAs<QuickList>(shard, key)) {
+        return list->toVector(); // Return the list if it exists
     }
     return {};
 }
 
-size_t Database::hset(const std::vector<std::string>& args) {
-    std::lock_guard<std::mutex> lock(db_mutex);
+size_t Database::hset(const std::vector<std::string_view>& args) {
     if (args.size() < 4 || args.size() % 2 != 0) {
         return 0; // Invalid number of arguments
     }
 
-    std::string key = args[1];
+    std::string_view key = args[1];
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
     size_t numInserts = 0;
 
+    Hash* hash = lookupOrCreate<Hash>(shard, key);
+    if (hash == nullptr) {
+        return 0; // Key holds another type
+    }
+    size_t before = hash->memoryUsage();
     for (size_t i = 2; i < args.size(); i += 2) {
-        const std::string& field = args[i];
-        const std::string& value = args[i + 1];
-        hashStore[key][field] = value;
+        std::string_view field = args[i];
+        std::string_view value = args[i + 1];
+        hash->set(field, value);
         numInserts++;
     }
+    chargeMemory(shard, before, hash->memoryUsage());
+    propagate(shard, args);
 
     return numInserts; // Return the number of fields inserted
 }
 
-std::string Database::hget(const std::string& key, const std::string& field) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    auto it = hashStore.find(key);
-    if (it != hashStore.end()) {
-        auto fieldIt = it->second.find(field);
-        if (fieldIt != it->second.end()) {
-            return fieldIt->second; // Return the value for the field
+std::string Database::hget(std::string_view key, std::string_view field) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (Hash* hash = lookupAs<Hash>(shard, key)) {
+        std::string value;
+        if (hash->get(field, value)) {
+            return value; // Return the value for the field
         }
     }
     return ""; // Return empty string if key or field does not exist
 }
 
-size_t Database::hdel(const std::string& key, const std::string& field) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    auto it = hashStore.find(key);
-    if (it != hashStore.end()) {
-        auto& hashMap = it->second;
-        auto fieldIt = hashMap.find(field);
-        if (fieldIt != hashMap.end()) {
-            hashMap.erase(fieldIt);
-            if (hashMap.empty()) {
-                hashStore.erase(it);
+size_t Database::hdel(std::string_view key, std::string_view field) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (Hash* hash = lookupAs<Hash>(shard, key)) {
+        size_t before = hash->memoryUsage();
+        if (hash->erase(field)) {
+            chargeMemory(shard, before, hash->memoryUsage());
+            propagate(shard, {"HDEL", key, field});
+            if (hash->empty()) {
+                removeKey(shard, shard.keyspace.find(key));
             }
             return 1;
         }
@@ -384,97 +953,343 @@ size_t Database::hdel(const std::string& key, const std::string& field) {
     return 0; // Return 0 if key does not exist
 }
 
-bool Database::hexists(const std::string& key, const std::string& field) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    auto it = hashStore.find(key);
-    if (it != hashStore.end()) {
-        return it->second.find(field) != it->second.end(); // Check if field exists
+bool Database::hexists(std::string_view key, std::string_view field) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (Hash* hash = lookupAs<Hash>(shard, key)) {
+        return hash->contains(field); // Check if field exists
     }
     return false; // Return false if key does not exist
 }
 
-std::unordered_map<std::string, std::string> Database::hgetall(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    auto it = hashStore.find(key);
-    if (it != hashStore.end()) {
-        return it->second; // Return the entire hash map
+StringMap<std::string> Database::hgetall(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (Hash* hash = lookupAs<Hash>(shard, key)) {
+        return hash->toMap(); // Return the entire hash map
     }
     return {}; // Return empty map if key does not exist
 }
 
-std::vector<std::string> Database::hkeys(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    auto it = hashStore.find(key);
-    if (it != hashStore.end()) {
-        std::vector<std::string> keys;
-        for (const auto& field : it->second) {
-            keys.push_back(field.first); // Collect all field names
+uint64_t Database::hscan(std::string_view key, uint64_t cursor, size_t count, std::string_view pattern,
+                         std::vector<std::pair<std::string, std::string>>& fields) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Hash* hash = lookupAs<Hash>(shard, key);
+    if (hash == nullptr) {
+        return 0; // Nothing to walk
+    }
+    bool matchAll = pattern == "*";
+    return hash->scan(cursor, count, [&](std::string_view field, std::string_view value) {
+        if (matchAll || globMatch(pattern, field)) {
+            fields.emplace_back(field, value);
         }
+    });
+}
+
+std::vector<std::string> Database::hkeys(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (Hash* hash = lookupAs<Hash>(shard, key)) {
+        std::vector<std::string> keys;
+        keys.reserve(hash->size());
+        hash->forEach([&keys](std::string_view field, std::string_view) {
+            keys.emplace_back(field); // Collect all field names
+        });
         return keys; // Return the list of field names
     }
     return {}; // Return empty vector if key does not exist
 }
 
-std::vector<std::string> Database::hvals(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    auto it = hashStore.find(key);
-    if (it != hashStore.end()) {
+std::vector<std::string> Database::hvals(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (Hash* hash = lookupAs<Hash>(shard, key)) {
         std::vector<std::string> values;
-        for (const auto& field : it->second) {
-            values.push_back(field.second); // Collect all field values
-        }
+        values.reserve(hash->size());
+        hash->forEach([&values](std::string_view, std::string_view value) {
+            values.emplace_back(value); // Collect all field values
+        });
         return values; // Return the list of field values
     }
     return {}; // Return empty vector if key does not exist
 }
 
-size_t Database::hlen(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    auto it = hashStore.find(key);
-    if (it != hashStore.end()) {
-        return it->second.size(); // Return the number of fields in the hash
+size_t Database::hlen(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (Hash* hash = lookupAs<Hash>(shard, key)) {
+        return hash->size(); // Return the number of fields in the hash
     }
     return 0; // Return 0 if key does not exist
 }
 
-
-bool Database::expiry(const std::string& key, int seconds) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    purgeExpired();
-    bool exists = keyValueStore.find(key) != keyValueStore.end() ||
-                     listStore.find(key) != listStore.end() ||
-                     hashStore.find(key) != hashStore.end();
-    if (!exists) {
-        return false; // Key does not exist
+void Database::setExpiry(Shard& shard, KeyEntry& entry, Object::Clock::time_point when) {
+    Object& object = entry.second;
+    object.expiresAt = when;
+    if (object.heapIndex != Object::NOT_IN_HEAP) {
+        if (when == Object::NO_EXPIRY) {
+            heapRemove(shard, object.heapIndex);
+        } else {
+            heapFix(shard, object.heapIndex);
+        }
+    } else if (when != Object::NO_EXPIRY) {
+        heapPush(shard, entry);
     }
-    if (seconds <= 0) {
-        // If seconds is 0 or negative, remove the key from expiryStore
-        expiryStore.erase(key);
+}
+
+void Database::removeKey(Shard& shard, Keyspace::iterator it) {
+    chargeMemory(shard, entryMemory(it->first, it->second), 0);
+    if (it->second.heapIndex != Object::NOT_IN_HEAP) {
+        heapRemove(shard, it->second.heapIndex);
     }
-    else {
-        // Set the expiry time to now + seconds
-        expiryStore[key] = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    shard.keyspace.erase(it);
+}
+
+// Indexed binary min-heap on expiresAt. Every move goes through heapSet so
+// each Object always knows its slot.
+void Database::heapSet(Shard& shard, uint32_t index, KeyEntry* entry) {
+    shard.expiryHeap[index] = entry;
+    entry->second.heapIndex = index;
+}
+
+void Database::heapPush(Shard& shard, KeyEntry& entry) {
+    shard.expiryHeap.push_back(&entry);
+    heapFix(shard, static_cast<uint32_t>(shard.expiryHeap.size() - 1));
+}
+
+void Database::heapRemove(Shard& shard, uint32_t index) {
+    auto& heap = shard.expiryHeap;
+    heap[index]->second.heapIndex = Object::NOT_IN_HEAP;
+    KeyEntry* last = heap.back();
+    heap.pop_back();
+    if (index < heap.size()) {
+        heapSet(shard, index, last);
+        heapFix(shard, index);
     }
-    return true;
 }
 
+// Moves the entry at index up or down until the heap order holds again
+void Database::heapFix(Shard& shard, uint32_t index) {
+    auto& heap = shard.expiryHeap;
+    KeyEntry* entry = heap[index];
+    auto when = entry->second.expiresAt;
+
+    while (index > 0) {
+        uint32_t parent = (index - 1) / 2;
+        if (heap[parent]->second.expiresAt <= when) {
+            break;
+        }
+        heapSet(shard, index, heap[parent]);
+        index = parent;
+    }
+    while (true) {
+        size_t child = 2 * static_cast<size_t>(index) + 1;
+        if (child >= heap.size()) {
+            break;
+        }
+        if (child + 1 < heap.size() && heap[child + 1]->second.expiresAt < heap[child]->second.expiresAt) {
+            child++;
+        }
+        if (when <= heap[child]->second.expiresAt) {
+            break;
+        }
+        heapSet(shard, index, heap[child]);
+        index = static_cast<uint32_t>(child);
+    }
+    heapSet(shard, index, entry);
+}
 
-void Database::purgeExpired() {
+// Pops due keys off the shard's expiry heap, deleting at most `limit` of them
+size_t Database::purgeExpired(Shard& shard, size_t limit) {
     auto now = std::chrono::steady_clock::now();
-    
-    for (auto it = expiryStore.begin(); it != expiryStore.end();) {
-        if (it->second <= now) {
-            // If the key has expired, remove it from all stores
-            keyValueStore.erase(it->first);
-            listStore.erase(it->first);
-            hashStore.erase(it->first);
-            it = expiryStore.erase(it); // Remove from expiry store and get next iterator
-        } else {
-            ++it; // Move to the next item
+    size_t expired = 0;
+
+    while (!shard.expiryHeap.empty() && expired < limit) {
+        KeyEntry* top = shard.expiryHeap.front();
+        if (top->second.expiresAt > now) {
+            break; // Nothing else is due yet
+        }
+        expireKey(shard, shard.keyspace.find(top->first));
+        expired++;
+    }
+    return expired;
+}
+
+void Database::beginLoading() {
+    loading.store(true, std::memory_order_relaxed);
+}
+
+void Database::endLoading() {
+    loading.store(false, std::memory_order_relaxed);
+}
+
+size_t Database::activeExpireCycle(std::chrono::microseconds budget) {
+    auto start = std::chrono::steady_clock::now();
+    size_t expired = 0;
+    size_t idleShards = 0; // Consecutive shards with nothing left to expire
+
+    // Round robin over the shards, one bounded batch per lock hold, until the
+    // time budget runs out or a full pass finds nothing more to do
+    while (idleShards < SHARD_COUNT) {
+        Shard& shard = shards[expireCursor.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT];
+        size_t count;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            count = purgeExpired(shard, EXPIRE_BATCH);
+        }
+        expired += count;
+        idleShards = count < EXPIRE_BATCH ? idleShards + 1 : 0;
+
+        if (std::chrono::steady_clock::now() - start >= budget) {
+            break;
+        }
+    }
+    LatencyMonitor::getInstance().record("expire-cycle", start);
+    return expired;
+}
+
+bool Database::incrementalRehash(std::chrono::microseconds budget) {
+    auto start = std::chrono::steady_clock::now();
+    for (auto& shard : shards) {
+        bool resizing = true;
+        while (resizing) {
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                resizing = shard.keyspace.rehash(REHASH_BATCH);
+            }
+            if (resizing && std::chrono::steady_clock::now() - start >= budget) {
+                LatencyMonitor::getInstance().record("rehash-cycle", start);
+                return true;
+            }
+        }
+    }
+    LatencyMonitor::getInstance().record("rehash-cycle", start);
+    return false;
+}
+
+void Database::setMaxMemory(size_t bytes, EvictionPolicy policy) {
+    maxMemory = bytes;
+    evictionPolicy = policy;
+}
+
+size_t Database::usedMemory() {
+    size_t total = 0;
+    for (const auto& shard : shards) {
+        total += shard.usedMemory.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::optional<size_t> Database::memoryUsage(std::string_view key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (lookup(shard, key) == nullptr) {
+        return std::nullopt;
+    }
+    const KeyEntry& entry = *shard.keyspace.find(key);
+    return entryMemory(entry.first, entry.second);
+}
+
+bool Database::freeMemoryIfNeeded() {
+    if (maxMemory == 0) {
+        return true;
+    }
+    while (usedMemory() > maxMemory) {
+        if (evictionPolicy == EvictionPolicy::NoEviction || !evictOne()) {
+            return false;
         }
     }
+    return true;
+}
+
+// How good a candidate for eviction the object is under the policy; higher
+// is better. Comparable across shards as long as `now` was read for each.
+int64_t Database::evictionScore(const Object& object, uint32_t now) const {
+    switch (evictionPolicy) {
+        case EvictionPolicy::AllKeysLfu:
+            return UINT8_MAX - object.lfuDecayed(now);
+        case EvictionPolicy::VolatileTtl:
+            return -object.expiresAt.time_since_epoch().count(); // The sooner it expires the better
+        default:
+            return object.idleTime(now);
+    }
 }
 
+// Picks the key the policy would drop from the shard, or nullptr if it has
+// none. LRU and LFU compare EVICTION_SAMPLES keys from random buckets instead
+// of keeping the keys ordered, so the cost per eviction does not depend on
+// the number of keys; volatile-ttl takes the top of the expiry heap.
+Database::KeyEntry* Database::evictionCandidate(Shard& shard, uint32_t now) {
+    if (evictionPolicy == EvictionPolicy::VolatileTtl) {
+        return shard.expiryHeap.empty() ? nullptr : shard.expiryHeap.front();
+    }
+    if (shard.keyspace.empty()) {
+        return nullptr;
+    }
+
+    thread_local std::minstd_rand rng{std::random_device{}()};
+    KeyEntry* best = nullptr;
+    int64_t bestScore = 0;
+    size_t sampled = 0;
+    size_t buckets = shard.keyspace.bucketCount();
+    for (size_t probe = 0; probe < EVICTION_PROBES && sampled < EVICTION_SAMPLES; probe++) {
+        shard.keyspace.forEachInBucket(rng() % buckets, [&](KeyEntry& entry) {
+            if (sampled == EVICTION_SAMPLES) {
+                return;
+            }
+            int64_t score = evictionScore(entry.second, now);
+            if (best == nullptr || score > bestScore) {
+                best = &entry;
+                bestScore = score;
+            }
+            sampled++;
+        });
+    }
+    return best;
+}
 
+// Evicts one key: the best of the candidates from EVICTION_SHARDS shards,
+// taken in turn from a random one, so a key competes with keys from more
+// than its own shard. The shards are locked one at a time, so the winner is
+// looked up again before it is deleted. The eviction is logged as a DEL so
+// the log replays to the same dataset.
+bool Database::evictOne() {
+    thread_local std::minstd_rand rng{std::random_device{}()};
+    size_t start = rng() % SHARD_COUNT;
 
+    Shard* bestShard = nullptr;
+    std::string bestKey;
+    int64_t bestScore = 0;
+    size_t sampledShards = 0;
+    for (size_t i = 0; i < SHARD_COUNT && sampledShards < EVICTION_SHARDS; i++) {
+        Shard& shard = shards[(start + i) % SHARD_COUNT];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        // Read under the lock so no key in the shard was touched after it
+        uint32_t now = currentLruClock();
+        KeyEntry* candidate = evictionCandidate(shard, now);
+        if (candidate == nullptr) {
+            continue;
+        }
+        sampledShards++;
+        int64_t score = evictionScore(candidate->second, now);
+        if (bestShard == nullptr || score > bestScore) {
+            bestShard = &shard;
+            bestKey.assign(candidate->first.view());
+            bestScore = score;
+        }
+    }
+    if (bestShard == nullptr) {
+        return false;
+    }
 
+    std::lock_guard<std::mutex> lock(bestShard->mutex);
+    auto it = bestShard->keyspace.find(bestKey);
+    if (it != bestShard->keyspace.end()) {
+        propagate(*bestShard, {"DEL", bestKey});
+        removeKey(*bestShard, it);
+        evictedKeys.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Otherwise it was deleted or renamed meanwhile; the caller checks the memory again
+    return true;
+}
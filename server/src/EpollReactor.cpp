@@ -0,0 +1,249 @@
+#include "../include/EpollReactor.h"
+#include "../include/Aof.h"
+#include "../include/Logger.h"
+#include "../include/Stats.h"
+#include "../include/LatencyMonitor.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <vector>
+#include <cstring>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <algorithm>
+
+EpollReactor::EpollReactor(int id, int port, std::atomic<bool>& running)
+    : Reactor(id, port, running) {}
+
+EpollReactor::~EpollReactor() {
+    for (auto& client : clients) {
+        close(client.second.socket);
+    }
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+    if (serverSocket >= 0) {
+        close(serverSocket);
+    }
+}
+
+bool EpollReactor::setup() {
+    serverSocket = openListenSocket();
+    if (serverSocket < 0) {
+        return false;
+    }
+
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0) {
+        LOG_ERROR("Failed to create epoll instance.");
+        return false;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = serverSocket;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, serverSocket, &ev) == -1) {
+        LOG_ERROR("Failed to add server socket to epoll.");
+        return false;
+    }
+
+    return true;
+}
+
+void EpollReactor::run() {
+    // Create an array to hold events
+    std::vector<struct epoll_event> events(MAX_CLIENTS);
+
+    nextCron = std::chrono::steady_clock::now() + CRON_INTERVAL;
+
+    while (running) {
+        int n = epoll_wait(epoll_fd, events.data(), MAX_CLIENTS, EPOLL_TIMEOUT_MS);
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            // Accept new client connections
+            if (fd == serverSocket) {
+                acceptClients();
+                continue;
+            }
+
+            auto it = clients.find(fd);
+            if (it == clients.end()) {
+                continue; // Closed earlier in this batch
+            }
+            EpollClient& client = it->second;
+
+            if ((events[i].events & EPOLLIN) && !readFromClient(client)) {
+                closeClient(fd);
+                continue;
+            }
+
+            if (events[i].events & EPOLLOUT) {
+                queueWrite(client); // Sent with the rest below
+            }
+        }
+
+        // Commit this iteration's writes before any of their replies can go out
+        flushPendingWrites(Aof::getInstance().flush());
+
+        runCronIfDue();
+        LatencyMonitor::getInstance().record("event-loop", start);
+    }
+}
+
+void EpollReactor::acceptClients() {
+    // Edge triggered: drain the accept queue
+    while (true) {
+        struct sockaddr_in clientAddr;
+        socklen_t clientAddrLen = sizeof(clientAddr);
+
+        int clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientAddrLen);
+        if (clientSocket < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR("Failed to accept client connection.");
+            }
+            return;
+        }
+
+        if (clients.size() >= MAX_CLIENTS) {
+            LOG_WARNING("Maximum number of clients reached. Closing new connection.");
+            close(clientSocket);
+            Stats::getInstance().connectionRejected();
+            continue;
+        }
+        LOG_DEBUG("Reactor " << id << " accepted new client connection: " << clientSocket);
+        // Set client socket to non-blocking mode
+        if (fcntl(clientSocket, F_SETFL, O_NONBLOCK) < 0) {
+            LOG_ERROR("Failed to set client socket to non-blocking mode.");
+            close(clientSocket);
+            continue;
+        }
+        struct epoll_event clientEv;
+        clientEv.events = EPOLLIN | EPOLLET;
+        clientEv.data.fd = clientSocket;
+
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, clientSocket, &clientEv) == -1) {
+            LOG_ERROR("Failed to add client socket to epoll.");
+            close(clientSocket);
+            LOG_DEBUG("Client connection closed: " << clientSocket);
+            continue;
+        }
+
+        clients[clientSocket].socket = clientSocket;
+        Stats::getInstance().clientConnected();
+    }
+}
+
+// Returns false if the client has to be closed
+bool EpollReactor::readFromClient(EpollClient& client) {
+    while (!client.closeAfterWrite) {
+        compactReadBuffer(client);
+
+        // Receive straight into the read buffer. While a large bulk string is
+        // arriving the parser knows how much is missing, so read that much at
+        // once instead of BUFFER_SIZE at a time.
+        size_t readSize = std::max<size_t>(BUFFER_SIZE, std::min(client.parser.bytesNeeded(), MAX_READ_SIZE));
+        size_t oldSize = client.readBuffer.size();
+        client.readBuffer.resize(oldSize + readSize);
+
+        ssize_t bytesRead = recv(client.socket, client.readBuffer.data() + oldSize, readSize, 0);
+        client.readBuffer.resize(oldSize + (bytesRead > 0 ? bytesRead : 0));
+
+        if (bytesRead < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // No more data to read
+                return true;
+            }
+            LOG_WARNING("Error reading from client socket.");
+            return false;
+        } else if (bytesRead == 0) {
+            // Client disconnected
+            return false;
+        }
+
+        processInput(client); // A protocol error stops the loop; the client closes once its replies are out
+    }
+    return true;
+}
+
+void EpollReactor::queueWrite(Client& client) {
+    if (!client.queued) {
+        client.queued = true;
+        pendingWrites.push_back(client.socket);
+    }
+}
+
+// Sends every reply produced in this iteration, one send per client. If the
+// log could not be synced, the clients whose commands were logged are
+// disconnected unanswered instead; the others get their replies.
+void EpollReactor::flushPendingWrites(bool logSynced) {
+    for (int fd : pendingWrites) {
+        auto it = clients.find(fd);
+        if (it == clients.end()) {
+            continue; // Closed after its reply was queued
+        }
+        EpollClient& client = it->second;
+        client.queued = false;
+        bool unsynced = client.awaitingSync && !logSynced;
+        client.awaitingSync = false;
+        // After a protocol error the reply is sent best effort, then the connection closed
+        if (unsynced || !writeToClient(client) || client.closeAfterWrite) {
+            closeClient(fd);
+        }
+    }
+    pendingWrites.clear();
+}
+
+// Writes straight to the socket and only registers for EPOLLOUT when it
+// would block. Returns false if the client has to be closed
+bool EpollReactor::writeToClient(EpollClient& client) {
+    while (client.writePos < client.writeBuffer.size()) {
+        ssize_t bytesWritten = send(client.socket, client.writeBuffer.data() + client.writePos,
+                                    client.writeBuffer.size() - client.writePos, MSG_NOSIGNAL);
+        if (bytesWritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Socket buffer full, finish on EPOLLOUT
+                if (!client.writeArmed && !setClientEvents(client.socket, EPOLLIN | EPOLLOUT | EPOLLET)) {
+                    LOG_ERROR("Failed to modify client socket for write.");
+                    return false;
+                }
+                client.writeArmed = true;
+                return true;
+            }
+            LOG_WARNING("Error writing to client socket.");
+            return false;
+        }
+        client.writePos += bytesWritten;
+    }
+
+    client.writeBuffer.clear();
+    client.writePos = 0;
+    if (client.writeArmed) {
+        client.writeArmed = false;
+        if (!setClientEvents(client.socket, EPOLLIN | EPOLLET)) {
+            LOG_ERROR("Failed to modify client socket for read.");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool EpollReactor::setClientEvents(int clientFd, uint32_t events) {
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = clientFd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, clientFd, &ev) != -1;
+}
+
+void EpollReactor::closeClient(int clientFd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, clientFd, nullptr);
+    close(clientFd);
+    LOG_DEBUG("Client connection closed: " << clientFd);
+    clients.erase(clientFd);
+    Stats::getInstance().clientDisconnected();
+}
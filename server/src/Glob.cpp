@@ -0,0 +1,84 @@
+#include "../include/Glob.h"
+#include <utility>
+
+// Matches the single-byte element at pattern[p] (anything but *) against c.
+// Sets next to the element after it.
+static bool matchOne(std::string_view pattern, size_t p, char c, size_t& next) {
+    switch (pattern[p]) {
+        case '?':
+            next = p + 1;
+            return true;
+        case '\\':
+            if (p + 1 < pattern.size()) {
+                next = p + 2;
+                return pattern[p + 1] == c;
+            }
+            next = p + 1;
+            return c == '\\'; // Trailing backslash is literal
+        case '[': {
+            size_t i = p + 1;
+            bool negate = i < pattern.size() && pattern[i] == '^';
+            if (negate) {
+                i++;
+            }
+            bool matched = false;
+            while (i < pattern.size() && pattern[i] != ']') {
+                if (pattern[i] == '\\' && i + 1 < pattern.size()) {
+                    matched |= pattern[i + 1] == c;
+                    i += 2;
+                } else if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+                    unsigned char low = pattern[i], high = pattern[i + 2];
+                    if (low > high) {
+                        std::swap(low, high);
+                    }
+                    unsigned char value = c;
+                    matched |= value >= low && value <= high;
+                    i += 3;
+                } else {
+                    matched |= pattern[i] == c;
+                    i++;
+                }
+            }
+            next = i < pattern.size() ? i + 1 : i; // An unclosed class runs to the end
+            return matched != negate;
+        }
+        default:
+            next = p + 1;
+            return pattern[p] == c;
+    }
+}
+
+// On a mismatch, backtracks to the most recent star and lets it swallow one
+// more byte. Earlier stars never need revisiting, so the cost stays
+// O(pattern * text) instead of exponential in the number of stars.
+bool globMatch(std::string_view pattern, std::string_view text) {
+    size_t p = 0, t = 0;
+    size_t starPattern = std::string_view::npos; // Element after the last star seen
+    size_t starText = 0; // Where the text stood when that star was reached
+
+    while (t < text.size()) {
+        if (p < pattern.size()) {
+            if (pattern[p] == '*') {
+                starPattern = ++p;
+                starText = t;
+                continue;
+            }
+            size_t next;
+            if (matchOne(pattern, p, text[t], next)) {
+                p = next;
+                t++;
+                continue;
+            }
+        }
+        if (starPattern == std::string_view::npos) {
+            return false;
+        }
+        p = starPattern;
+        t = ++starText;
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') {
+        p++;
+    }
+    return p == pattern.size();
+}
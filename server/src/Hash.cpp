@@ -0,0 +1,197 @@
+#include "../include/Hash.h"
+#include "../include/Encoding.h"
+#include "../include/Slab.h"
+
+size_t Hash::maxPackedEntries = 128;
+size_t Hash::maxPackedValue = 64;
+
+void Hash::setLimits(size_t maxEntries, size_t maxValue) {
+    maxPackedEntries = maxEntries;
+    maxPackedValue = maxValue;
+}
+
+Hash::Hash(const Hash& other) : packed(other.packed), count(other.count) { // Copies tableBytes too
+    if (other.table) {
+        table = std::make_unique<Dict<CompactString, CompactString>>(*other.table);
+    }
+}
+
+Hash& Hash::operator=(const Hash& other) {
+    if (this != &other) {
+        Hash copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+size_t Hash::tableEntryMemory(const CompactString& field, const CompactString& value) {
+    return Slab::allocationSize(TABLE_NODE_SIZE) + field.memoryUsage() + value.memoryUsage();
+}
+
+size_t Hash::memoryUsage() const {
+    if (table) {
+        return sizeof(*table) + table->bucketCount() * sizeof(void*) + tableBytes;
+    }
+    return stringMemory(packed);
+}
+
+// Reads the pair at offset, returns the offset of the next one
+size_t Hash::readPair(size_t offset, std::string_view& field, std::string_view& value) const {
+    const char* end = packed.data() + packed.size();
+    uint64_t len;
+
+    const char* p = packed.data() + offset;
+    p += decodeVarint(p, end, len);
+    field = std::string_view(p, len);
+    p += len;
+
+    p += decodeVarint(p, end, len);
+    value = std::string_view(p, len);
+    p += len;
+
+    return p - packed.data();
+}
+
+// Offset of the pair holding field in packed, or npos. valueOffset is set to
+// the start of its value length.
+size_t Hash::find(std::string_view field, size_t& valueOffset) const {
+    const char* end = packed.data() + packed.size();
+    size_t offset = 0;
+    while (offset < packed.size()) {
+        uint64_t len;
+        const char* p = packed.data() + offset;
+        p += decodeVarint(p, end, len);
+        bool match = std::string_view(p, len) == field;
+        p += len;
+        size_t valueStart = p - packed.data();
+        p += decodeVarint(p, end, len);
+        p += len;
+        if (match) {
+            valueOffset = valueStart;
+            return offset;
+        }
+        offset = p - packed.data();
+    }
+    return std::string::npos;
+}
+
+void Hash::convertToTable() {
+    auto converted = std::make_unique<Dict<CompactString, CompactString>>();
+    converted->reserve(count + 1);
+    size_t bytes = 0;
+    forEach([&converted, &bytes](std::string_view field, std::string_view value) {
+        auto entry = converted->emplace(CompactString(field), CompactString(value)).first;
+        bytes += tableEntryMemory(entry->first, entry->second);
+    });
+    table = std::move(converted);
+    packed.clear();
+    packed.shrink_to_fit();
+    tableBytes = bytes;
+}
+
+bool Hash::get(std::string_view field, std::string& value) const {
+    if (table) {
+        auto it = table->find(field);
+        if (it == table->end()) {
+            return false;
+        }
+        value = it->second.view();
+        return true;
+    }
+
+    size_t valueOffset;
+    if (find(field, valueOffset) == std::string::npos) {
+        return false;
+    }
+    uint64_t len;
+    const char* p = packed.data() + valueOffset;
+    p += decodeVarint(p, packed.data() + packed.size(), len);
+    value.assign(p, len);
+    return true;
+}
+
+bool Hash::contains(std::string_view field) const {
+    if (table) {
+        return table->find(field) != table->end();
+    }
+    size_t valueOffset;
+    return find(field, valueOffset) != std::string::npos;
+}
+
+bool Hash::set(std::string_view field, std::string_view value) {
+    if (!table && (field.size() > maxPackedValue || value.size() > maxPackedValue)) {
+        convertToTable();
+    }
+
+    if (table) {
+        auto it = table->find(field);
+        if (it != table->end()) {
+            tableBytes -= it->second.memoryUsage();
+            it->second = CompactString(value);
+            tableBytes += it->second.memoryUsage();
+            return false;
+        }
+        auto entry = table->emplace(CompactString(field), CompactString(value)).first;
+        tableBytes += tableEntryMemory(entry->first, entry->second);
+        return true;
+    }
+
+    size_t valueOffset;
+    size_t offset = find(field, valueOffset);
+    if (offset != std::string::npos) {
+        // Overwrite the value in place, shifting the rest of the buffer if its size changed
+        uint64_t len;
+        size_t header = decodeVarint(packed.data() + valueOffset, packed.data() + packed.size(), len);
+        std::string encoded;
+        appendVarint(encoded, value.size());
+        encoded.append(value);
+        packed.replace(valueOffset, header + len, encoded);
+        return false;
+    }
+
+    if (count + 1 > maxPackedEntries) {
+        convertToTable();
+        auto entry = table->emplace(CompactString(field), CompactString(value)).first;
+        tableBytes += tableEntryMemory(entry->first, entry->second);
+        return true;
+    }
+
+    appendVarint(packed, field.size());
+    packed.append(field);
+    appendVarint(packed, value.size());
+    packed.append(value);
+    count++;
+    return true;
+}
+
+bool Hash::erase(std::string_view field) {
+    if (table) {
+        auto it = table->find(field);
+        if (it == table->end()) {
+            return false;
+        }
+        tableBytes -= tableEntryMemory(it->first, it->second);
+        table->erase(it);
+        return true;
+    }
+
+    size_t valueOffset;
+    size_t offset = find(field, valueOffset);
+    if (offset == std::string::npos) {
+        return false;
+    }
+    uint64_t len;
+    size_t header = decodeVarint(packed.data() + valueOffset, packed.data() + packed.size(), len);
+    packed.erase(offset, valueOffset + header + len - offset);
+    count--;
+    return true;
+}
+
+StringMap<std::string> Hash::toMap() const {
+    StringMap<std::string> map;
+    map.reserve(size());
+    forEach([&map](std::string_view field, std::string_view value) {
+        map.emplace(std::string(field), std::string(value));
+    });
+    return map;
+}
@@ -0,0 +1,176 @@
+#include "../include/IoUring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+IoUring::~IoUring() {
+    if (ringFd >= 0) {
+        close(ringFd); // Cancels whatever is still in flight
+    }
+    if (bufferRing != nullptr) {
+        munmap(bufferRing, bufferRingSize);
+    }
+    if (bufferPool != nullptr) {
+        munmap(bufferPool, static_cast<size_t>(bufferCount) * bufferSize);
+    }
+    if (sqes != nullptr) {
+        munmap(sqes, sqesSize);
+    }
+    if (cqRingPtr != nullptr && cqRingPtr != sqRingPtr) {
+        munmap(cqRingPtr, cqRingSize);
+    }
+    if (sqRingPtr != nullptr) {
+        munmap(sqRingPtr, sqRingSize);
+    }
+}
+
+bool IoUring::init(unsigned int entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd < 0) {
+        return false;
+    }
+    // Timed waits need EXT_ARG (5.11); the caller also relies on multishot
+    // accept/recv and buffer rings, which arrived later still
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        return false;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+
+    sqRingPtr = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRingPtr == MAP_FAILED) {
+        sqRingPtr = nullptr;
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cqRingPtr = sqRingPtr;
+    } else {
+        cqRingPtr = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRingPtr == MAP_FAILED) {
+            cqRingPtr = nullptr;
+            return false;
+        }
+    }
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* mapped = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe*>(mapped);
+
+    char* sq = static_cast<char*>(sqRingPtr);
+    sqHead = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+    sqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+    sqMask = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+    sqEntries = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_entries);
+    sqLocalTail = *sqTail;
+
+    char* cq = static_cast<char*>(cqRingPtr);
+    cqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    cqMask = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+    return true;
+}
+
+io_uring_sqe* IoUring::getSqe() {
+    unsigned int head = std::atomic_ref<unsigned int>(*sqHead).load(std::memory_order_acquire);
+    if (sqLocalTail - head >= sqEntries) {
+        enter(toSubmit, 0, 0, nullptr, 0); // Make room by handing what we have to the kernel
+        head = std::atomic_ref<unsigned int>(*sqHead).load(std::memory_order_acquire);
+        if (sqLocalTail - head >= sqEntries) {
+            return nullptr;
+        }
+    }
+    unsigned int index = sqLocalTail & sqMask;
+    sqArray[index] = index;
+    sqLocalTail++;
+    toSubmit++;
+    publishSubmissions();
+
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// Entries are published as they are handed out; the kernel only looks at
+// them once io_uring_enter is called, after the caller has filled them in
+void IoUring::publishSubmissions() {
+    std::atomic_ref<unsigned int>(*sqTail).store(sqLocalTail, std::memory_order_release);
+}
+
+int IoUring::submitAndWait(std::chrono::milliseconds timeout) {
+    __kernel_timespec ts;
+    ts.tv_sec = timeout.count() / 1000;
+    ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+    io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+    int result = enter(toSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (result < 0 && (errno == ETIME || errno == EINTR)) {
+        return 0;
+    }
+    return result;
+}
+
+int IoUring::enter(unsigned int submit, unsigned int waitNr, unsigned int flags, const void* arg, size_t argSize) {
+    int result = static_cast<int>(syscall(__NR_io_uring_enter, ringFd, submit, waitNr, flags, arg, argSize));
+    if (result > 0) {
+        toSubmit -= std::min<unsigned int>(toSubmit, result);
+    }
+    return result;
+}
+
+bool IoUring::setupBufferRing(uint16_t groupId, unsigned int count, unsigned int size) {
+    bufferRingSize = count * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        return false;
+    }
+    bufferRing = static_cast<io_uring_buf_ring*>(ring);
+
+    void* pool = mmap(nullptr, static_cast<size_t>(count) * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool == MAP_FAILED) {
+        return false;
+    }
+    bufferPool = static_cast<char*>(pool);
+    bufferCount = count;
+    bufferSize = size;
+
+    io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+    reg.ring_entries = count;
+    reg.bgid = groupId;
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return false; // Before 5.19
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        recycleBuffer(static_cast<uint16_t>(i));
+    }
+    return true;
+}
+
+void IoUring::recycleBuffer(uint16_t bufferId) {
+    // Entries are indexed by hand: in C++ the header's flex array member sits
+    // after an empty struct and so not at offset 0, where the kernel expects it
+    uint16_t tail = bufferRing->tail;
+    io_uring_buf& entry = reinterpret_cast<io_uring_buf*>(bufferRing)[tail & (bufferCount - 1)];
+    entry.addr = reinterpret_cast<uint64_t>(buffer(bufferId));
+    entry.len = static_cast<uint32_t>(bufferSize);
+    entry.bid = bufferId;
+    std::atomic_ref<uint16_t>(bufferRing->tail).store(tail + 1, std::memory_order_release);
+}
@@ -0,0 +1,88 @@
+#include "../include/LatencyMonitor.h"
+
+LatencyMonitor& LatencyMonitor::getInstance() {
+    static LatencyMonitor instance;
+    return instance;
+}
+
+void LatencyMonitor::setThreshold(std::chrono::milliseconds threshold) {
+    thresholdMillis.store(threshold.count(), std::memory_order_relaxed);
+}
+
+void LatencyMonitor::record(std::string_view event, std::chrono::steady_clock::time_point start) {
+    int64_t threshold = thresholdMillis.load(std::memory_order_relaxed);
+    if (threshold <= 0) {
+        return;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    if (elapsed.count() < threshold) {
+        return;
+    }
+    uint64_t millis = elapsed.count();
+    std::time_t now = std::time(nullptr);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = events.find(event);
+    if (it == events.end()) {
+        it = events.emplace(std::string(event), EventHistory()).first;
+    }
+    EventHistory& history = it->second;
+    if (millis > history.maxMillis) {
+        history.maxMillis = millis;
+    }
+    if (history.count > 0) {
+        Sample& last = history.samples[(history.next + HISTORY_LENGTH - 1) % HISTORY_LENGTH];
+        if (last.time == now) {
+            last.millis = millis > last.millis ? millis : last.millis; // Same second: keep the worst
+            return;
+        }
+    }
+    history.samples[history.next] = Sample{now, millis};
+    history.next = (history.next + 1) % HISTORY_LENGTH;
+    if (history.count < HISTORY_LENGTH) {
+        history.count++;
+    }
+}
+
+std::vector<LatencyMonitor::EventSummary> LatencyMonitor::latest() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<EventSummary> summaries;
+    for (const auto& [name, history] : events) {
+        const Sample& last = history.samples[(history.next + HISTORY_LENGTH - 1) % HISTORY_LENGTH];
+        summaries.push_back(EventSummary{name, last, history.maxMillis});
+    }
+    return summaries;
+}
+
+std::vector<LatencyMonitor::Sample> LatencyMonitor::history(std::string_view event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Sample> samples;
+    auto it = events.find(event);
+    if (it == events.end()) {
+        return samples;
+    }
+    const EventHistory& history = it->second;
+    size_t first = (history.next + HISTORY_LENGTH - history.count) % HISTORY_LENGTH;
+    for (size_t i = 0; i < history.count; i++) {
+        samples.push_back(history.samples[(first + i) % HISTORY_LENGTH]);
+    }
+    return samples;
+}
+
+size_t LatencyMonitor::reset(const std::vector<std::string_view>& names) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (names.empty()) {
+        size_t dropped = events.size();
+        events.clear();
+        return dropped;
+    }
+    size_t dropped = 0;
+    for (std::string_view name : names) {
+        auto it = events.find(name);
+        if (it != events.end()) {
+            events.erase(it);
+            dropped++;
+        }
+    }
+    return dropped;
+}
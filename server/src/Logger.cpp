@@ -0,0 +1,169 @@
+#include "../include/Logger.h"
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <unistd.h>
+
+Logger& Logger::getInstance() {
+    static Logger instance;
+    return instance;
+}
+
+Logger::~Logger() {
+    stop();
+}
+
+bool Logger::parseLevel(const std::string& name, LogLevel& level) {
+    if (name == "debug") {
+        level = LogLevel::Debug;
+    } else if (name == "info") {
+        level = LogLevel::Info;
+    } else if (name == "warning") {
+        level = LogLevel::Warning;
+    } else if (name == "error") {
+        level = LogLevel::Error;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void Logger::start() {
+    if (drainThread.joinable()) {
+        return;
+    }
+    for (size_t i = 0; i < RING_SIZE; i++) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    enqueuePos.store(0, std::memory_order_relaxed);
+    dequeuePos = 0;
+    stopping = false;
+    drainThread = std::thread(&Logger::drainLoop, this);
+    async.store(true, std::memory_order_release);
+}
+
+void Logger::stop() {
+    if (!drainThread.joinable()) {
+        return;
+    }
+    async.store(false, std::memory_order_release); // New messages go straight out
+    stopping = true;
+    drainThread.join();
+    drain(); // Anything pushed while the thread was finishing
+}
+
+void Logger::forked() {
+    // Only the forking thread exists in the child: no drain thread, and the
+    // ring or libc's locale and timezone locks may have been held by another
+    // thread. The parent reports the child's outcome, so the child stays quiet.
+    setLevel(LogLevel::Off);
+}
+
+void Logger::write(LogLevel level, std::string message) {
+    if (async.load(std::memory_order_acquire) && push(level, message)) {
+        return;
+    }
+    if (async.load(std::memory_order_relaxed)) {
+        dropped.fetch_add(1, std::memory_order_relaxed); // Ring full
+        return;
+    }
+    std::string line;
+    format(line, level, std::chrono::system_clock::now(), message);
+    writeOut(level, line);
+}
+
+bool Logger::push(LogLevel level, std::string& message) {
+    uint64_t pos = enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = ring[pos & (RING_SIZE - 1)];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == pos) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.level = level;
+                slot.time = std::chrono::system_clock::now();
+                slot.message = std::move(message);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (sequence < pos) {
+            return false; // The drain thread has not caught up
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t Logger::drain() {
+    std::string out, errors;
+    size_t count = 0;
+    while (true) {
+        Slot& slot = ring[dequeuePos & (RING_SIZE - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1) {
+            break;
+        }
+        format(slot.level >= LogLevel::Warning ? errors : out, slot.level, slot.time, slot.message);
+        slot.message.clear();
+        slot.sequence.store(dequeuePos + RING_SIZE, std::memory_order_release);
+        dequeuePos++;
+        count++;
+    }
+
+    uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0) {
+        format(errors, LogLevel::Warning, std::chrono::system_clock::now(),
+               std::to_string(lost) + " log messages dropped, logging is falling behind");
+    }
+    if (!out.empty()) {
+        writeOut(LogLevel::Info, out);
+    }
+    if (!errors.empty()) {
+        writeOut(LogLevel::Error, errors);
+    }
+    return count;
+}
+
+void Logger::drainLoop() {
+    while (!stopping) {
+        if (drain() == 0) {
+            std::this_thread::sleep_for(DRAIN_INTERVAL);
+        }
+    }
+    drain();
+}
+
+// "2026-01-31 12:00:00.123 INFO message"
+void Logger::format(std::string& out, LogLevel level, std::chrono::system_clock::time_point time, const std::string& message) {
+    static const char* const LEVEL_NAMES[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+
+    std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+    std::tm local;
+    localtime_r(&seconds, &local);
+    char stamp[32];
+    size_t len = std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+    len += std::snprintf(stamp + len, sizeof(stamp) - len, ".%03d ", static_cast<int>(millis));
+
+    out.append(stamp, len);
+    out.append(LEVEL_NAMES[static_cast<int>(level)]);
+    out.push_back(' ');
+    out.append(message);
+    out.push_back('\n');
+}
+
+// Warnings and errors go to stderr, the rest to stdout
+void Logger::writeOut(LogLevel level, const std::string& text) {
+    int fd = level >= LogLevel::Warning ? STDERR_FILENO : STDOUT_FILENO;
+    const char* data = text.data();
+    size_t left = text.size();
+    while (left > 0) {
+        ssize_t written = ::write(fd, data, left);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        left -= written;
+    }
+}
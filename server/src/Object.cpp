@@ -0,0 +1,52 @@
+#include "../include/Object.h"
+#include <random>
+
+static constexpr double LFU_LOG_FACTOR = 10.0;
+
+uint32_t currentLruClock() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    uint32_t clock = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+    return clock != Object::LRU_NEVER ? clock : clock + 1;
+}
+
+void Object::touch() {
+    uint32_t now = currentLruClock();
+    if (lruClock != LRU_NEVER) {
+        lfuCounter = lfuDecayed(now);
+    }
+    lruClock = now;
+
+    // Increment with probability 1 / (counter * factor + 1), so the 8-bit
+    // counter covers access rates from a few to millions
+    if (lfuCounter == UINT8_MAX) {
+        return;
+    }
+    thread_local std::minstd_rand rng{std::random_device{}()};
+    double base = lfuCounter > LFU_INIT ? lfuCounter - LFU_INIT : 0;
+    double p = 1.0 / (base * LFU_LOG_FACTOR + 1.0);
+    if (std::uniform_real_distribution<double>(0.0, 1.0)(rng) < p) {
+        lfuCounter++;
+    }
+}
+
+uint32_t Object::idleTime(uint32_t now) const {
+    uint32_t idle = now - lruClock;
+    return idle > INT32_MAX ? INT32_MAX : idle;
+}
+
+uint8_t Object::lfuDecayed(uint32_t now) const {
+    uint32_t periods = idleTime(now) / LFU_DECAY_MILLIS;
+    return periods >= lfuCounter ? 0 : static_cast<uint8_t>(lfuCounter - periods);
+}
+
+size_t Object::memoryUsage() const {
+    switch (type()) {
+        case ObjectType::String:
+            return sizeof(Object) + std::get<CompactString>(value).memoryUsage();
+        case ObjectType::List:
+            return sizeof(Object) + std::get<QuickList>(value).memoryUsage();
+        case ObjectType::Hash:
+            return sizeof(Object) + std::get<Hash>(value).memoryUsage();
+    }
+    return sizeof(Object);
+}
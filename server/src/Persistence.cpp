@@ -0,0 +1,115 @@
+#include "../include/Persistence.h"
+#include "../include/Database.h"
+#include "../include/Snapshot.h"
+#include "../include/Logger.h"
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+Persistence& Persistence::getInstance() {
+    static Persistence instance;
+    return instance;
+}
+
+void Persistence::configure(const std::string& filename, const std::vector<SaveRule>& rules) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->filename = filename;
+    saveRules = rules;
+    lastSave = std::time(nullptr);
+    lastSaveDirty = Database::getInstance().dirtyCount();
+}
+
+bool Persistence::backgroundSave() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return startSave();
+}
+
+bool Persistence::startSave() {
+    if (childPid != -1) {
+        return false;
+    }
+
+    lastAttempt = std::time(nullptr);
+    uint64_t dirty = Database::getInstance().dirtyCount(); // Read before the fork, so nothing is counted as saved twice
+    pid_t pid = Database::getInstance().forkSnapshot(filename);
+    if (pid < 0) {
+        LOG_ERROR("Background save failed: could not fork");
+        lastSaveOk = false;
+        return false;
+    }
+    childPid = pid;
+    childDirty = dirty;
+    childStart = std::chrono::steady_clock::now();
+    LOG_INFO("Background saving started by pid " << pid);
+    return true;
+}
+
+void Persistence::cron() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (childPid != -1) {
+        int status;
+        pid_t pid = waitpid(childPid, &status, WNOHANG);
+        if (pid == 0) {
+            return; // Still running
+        }
+        pid_t finished = childPid;
+        childPid = -1;
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - childStart);
+        lastSaveOk = pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (lastSaveOk) {
+            lastSave = std::time(nullptr);
+            lastSaveDirty = childDirty;
+            LOG_INFO("Background saving terminated with success in " << elapsed.count() << " ms");
+        } else {
+            LOG_ERROR("Background saving failed");
+            unlink(SnapshotWriter::tempFilenameFor(filename, finished).c_str());
+        }
+        return;
+    }
+
+    std::time_t now = std::time(nullptr);
+    if (!lastSaveOk && now - lastAttempt < RETRY_DELAY) {
+        return;
+    }
+    uint64_t changes = Database::getInstance().dirtyCount() - lastSaveDirty;
+    for (const SaveRule& rule : saveRules) {
+        if (changes >= rule.changes && now - lastSave >= static_cast<std::time_t>(rule.seconds)) {
+            LOG_INFO(changes << " changes in " << rule.seconds << " seconds. Saving...");
+            startSave();
+            return;
+        }
+    }
+}
+
+void Persistence::shutdown() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (childPid == -1) {
+        return;
+    }
+    kill(childPid, SIGKILL); // The final foreground save supersedes it
+    waitpid(childPid, nullptr, 0);
+    unlink(SnapshotWriter::tempFilenameFor(filename, childPid).c_str());
+    childPid = -1;
+}
+
+bool Persistence::saveInProgress() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return childPid != -1;
+}
+
+std::time_t Persistence::lastSaveTime() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastSave;
+}
+
+bool Persistence::lastSaveSucceeded() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastSaveOk;
+}
+
+uint64_t Persistence::changesSinceLastSave() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Database::getInstance().dirtyCount() - lastSaveDirty;
+}
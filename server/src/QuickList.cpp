@@ -0,0 +1,333 @@
+#include "../include/QuickList.h"
+#include "../include/Encoding.h"
+
+QuickList::~QuickList() {
+    clear();
+}
+
+QuickList::QuickList(const QuickList& other) {
+    for (const Node* node = other.head; node != nullptr; node = node->next) {
+        Node* copy = insertNode(tail, nullptr);
+        copy->data = node->data;
+        copy->count = node->count;
+        bytes += copy->data.capacity();
+    }
+    length = other.length;
+}
+
+QuickList& QuickList::operator=(const QuickList& other) {
+    if (this != &other) {
+        QuickList copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+QuickList::QuickList(QuickList&& other) noexcept
+    : head(other.head), tail(other.tail), length(other.length), bytes(other.bytes) {
+    other.head = nullptr;
+    other.tail = nullptr;
+    other.length = 0;
+    other.bytes = 0;
+}
+
+QuickList& QuickList::operator=(QuickList&& other) noexcept {
+    if (this != &other) {
+        clear();
+        head = other.head;
+        tail = other.tail;
+        length = other.length;
+        bytes = other.bytes;
+        other.head = nullptr;
+        other.tail = nullptr;
+        other.length = 0;
+        other.bytes = 0;
+    }
+    return *this;
+}
+
+void QuickList::clear() {
+    Node* node = head;
+    while (node != nullptr) {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+    head = nullptr;
+    tail = nullptr;
+    length = 0;
+    bytes = 0;
+}
+
+// Size of "[varint len][bytes][backlen]" for value
+size_t QuickList::entrySize(std::string_view value) {
+    size_t size = varintSize(value.size()) + value.size();
+    return size + varintSize(size); // backlen uses as many 7-bit groups as a varint
+}
+
+// Writes an entry of entrySize(value) bytes at out
+void QuickList::encodeEntry(char* out, std::string_view value) {
+    size_t size = encodeVarint(value.size(), out);
+    value.copy(out + size, value.size());
+    size += value.size();
+
+    // backlen: most significant group first, every byte but the first has the
+    // high bit set, so a reader starting at the last byte knows when to stop
+    char groups[10];
+    size_t n = 0;
+    uint64_t backlen = size;
+    do {
+        groups[n++] = static_cast<char>(backlen & 0x7F);
+        backlen >>= 7;
+    } while (backlen != 0);
+    for (size_t i = n; i-- > 0;) {
+        out[size++] = static_cast<char>(groups[i] | (i + 1 < n ? 0x80 : 0));
+    }
+}
+
+// Reads the entry at offset, returns the offset of the next one
+size_t QuickList::readEntry(const std::string& data, size_t offset, std::string_view& value) {
+    uint64_t len;
+    const char* start = data.data() + offset;
+    size_t header = decodeVarint(start, data.data() + data.size(), len);
+    value = std::string_view(start + header, len);
+    return offset + header + len + varintSize(header + len);
+}
+
+// Offset of the entry that ends at `end`, found through its backlen
+size_t QuickList::entryStartBefore(const std::string& data, size_t end) {
+    size_t p = end - 1;
+    uint64_t backlen = 0;
+    int shift = 0;
+    while (true) {
+        uint8_t byte = static_cast<uint8_t>(data[p]);
+        backlen |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+        shift += 7;
+        p--;
+    }
+    return p - backlen;
+}
+
+QuickList::Node* QuickList::insertNode(Node* prev, Node* next) {
+    Node* node = new Node();
+    node->prev = prev;
+    node->next = next;
+    if (prev != nullptr) {
+        prev->next = node;
+    } else {
+        head = node;
+    }
+    if (next != nullptr) {
+        next->prev = node;
+    } else {
+        tail = node;
+    }
+    bytes += sizeof(Node);
+    return node;
+}
+
+void QuickList::unlinkNode(Node* node) {
+    if (node->prev != nullptr) {
+        node->prev->next = node->next;
+    } else {
+        head = node->next;
+    }
+    if (node->next != nullptr) {
+        node->next->prev = node->prev;
+    } else {
+        tail = node->prev;
+    }
+    bytes -= sizeof(Node) + node->data.capacity();
+    delete node;
+}
+
+void QuickList::resizeData(Node* node, size_t oldCapacity) {
+    bytes += node->data.capacity() - oldCapacity;
+}
+
+void QuickList::pushFront(std::string_view value) {
+    size_t size = entrySize(value);
+    if (head == nullptr || head->data.size() + size > NODE_MAX_BYTES) {
+        insertNode(nullptr, head);
+    }
+    size_t capacity = head->data.capacity();
+    head->data.insert(0, size, '\0'); // Bounded by NODE_MAX_BYTES, not the list length
+    encodeEntry(head->data.data(), value);
+    resizeData(head, capacity);
+    head->count++;
+    length++;
+}
+
+void QuickList::pushBack(std::string_view value) {
+    size_t size = entrySize(value);
+    if (tail == nullptr || tail->data.size() + size > NODE_MAX_BYTES) {
+        insertNode(tail, nullptr);
+    }
+    size_t offset = tail->data.size();
+    size_t capacity = tail->data.capacity();
+    tail->data.resize(offset + size);
+    encodeEntry(tail->data.data() + offset, value);
+    resizeData(tail, capacity);
+    tail->count++;
+    length++;
+}
+
+bool QuickList::popFront(std::string& value) {
+    if (head == nullptr) {
+        return false;
+    }
+    std::string_view entry;
+    size_t end = readEntry(head->data, 0, entry);
+    value.assign(entry);
+    head->data.erase(0, end);
+    length--;
+    if (--head->count == 0) {
+        unlinkNode(head);
+    }
+    return true;
+}
+
+bool QuickList::popBack(std::string& value) {
+    if (tail == nullptr) {
+        return false;
+    }
+    size_t start = entryStartBefore(tail->data, tail->data.size());
+    std::string_view entry;
+    readEntry(tail->data, start, entry);
+    value.assign(entry);
+    tail->data.resize(start);
+    length--;
+    if (--tail->count == 0) {
+        unlinkNode(tail);
+    }
+    return true;
+}
+
+// Finds the node holding element `index` (already normalized) and the entry offset in it
+QuickList::Node* QuickList::locate(long long index, size_t& offset) const {
+    if (index < 0) {
+        index += static_cast<long long>(length);
+    }
+    if (index < 0 || index >= static_cast<long long>(length)) {
+        return nullptr;
+    }
+
+    // Skip whole nodes from whichever end is closer
+    Node* node;
+    size_t local;
+    if (static_cast<size_t>(index) < length / 2) {
+        node = head;
+        local = static_cast<size_t>(index);
+        while (local >= node->count) {
+            local -= node->count;
+            node = node->next;
+        }
+    } else {
+        size_t fromTail = length - 1 - static_cast<size_t>(index);
+        node = tail;
+        while (fromTail >= node->count) {
+            fromTail -= node->count;
+            node = node->prev;
+        }
+        local = node->count - 1 - fromTail;
+    }
+
+    offset = 0;
+    std::string_view entry;
+    for (size_t i = 0; i < local; i++) {
+        offset = readEntry(node->data, offset, entry);
+    }
+    return node;
+}
+
+bool QuickList::index(long long index, std::string& value) const {
+    size_t offset;
+    Node* node = locate(index, offset);
+    if (node == nullptr) {
+        return false;
+    }
+    std::string_view entry;
+    readEntry(node->data, offset, entry);
+    value.assign(entry);
+    return true;
+}
+
+bool QuickList::set(long long index, std::string_view value) {
+    size_t offset;
+    Node* node = locate(index, offset);
+    if (node == nullptr) {
+        return false;
+    }
+    std::string_view entry;
+    size_t end = readEntry(node->data, offset, entry);
+    size_t size = entrySize(value);
+    size_t capacity = node->data.capacity();
+    node->data.replace(offset, end - offset, size, '\0');
+    encodeEntry(node->data.data() + offset, value);
+    resizeData(node, capacity);
+    return true;
+}
+
+size_t QuickList::remove(long long count, std::string_view value) {
+    size_t limit = count == 0 ? SIZE_MAX : static_cast<size_t>(count < 0 ? -count : count);
+    size_t removed = 0;
+
+    if (count >= 0) {
+        Node* node = head;
+        while (node != nullptr && removed < limit) {
+            Node* next = node->next;
+            size_t offset = 0;
+            while (offset < node->data.size() && removed < limit) {
+                std::string_view entry;
+                size_t end = readEntry(node->data, offset, entry);
+                if (entry == value) {
+                    node->data.erase(offset, end - offset);
+                    node->count--;
+                    removed++;
+                } else {
+                    offset = end;
+                }
+            }
+            if (node->count == 0) {
+                unlinkNode(node);
+            }
+            node = next;
+        }
+    } else {
+        Node* node = tail;
+        while (node != nullptr && removed < limit) {
+            Node* prev = node->prev;
+            size_t end = node->data.size();
+            while (end > 0 && removed < limit) {
+                size_t start = entryStartBefore(node->data, end);
+                std::string_view entry;
+                readEntry(node->data, start, entry);
+                if (entry == value) {
+                    node->data.erase(start, end - start);
+                    node->count--;
+                    removed++;
+                }
+                end = start;
+            }
+            if (node->count == 0) {
+                unlinkNode(node);
+            }
+            node = prev;
+        }
+    }
+
+    length -= removed;
+    return removed;
+}
+
+std::vector<std::string> QuickList::toVector() const {
+    std::vector<std::string> items;
+    items.reserve(length);
+    forEach([&items](std::string_view item) {
+        items.emplace_back(item);
+    });
+    return items;
+}
@@ -0,0 +1,138 @@
+#include "../include/Reactor.h"
+#include "../include/EpollReactor.h"
+#include "../include/UringReactor.h"
+#include "../include/Database.h"
+#include "../include/Persistence.h"
+#include "../include/Aof.h"
+#include "../include/Logger.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+
+Reactor::Reactor(int id, int port, std::atomic<bool>& running)
+    : id(id), port(port), running(running) {}
+
+std::unique_ptr<Reactor> Reactor::create(IoBackend backend, int id, int port, std::atomic<bool>& running) {
+    if (backend == IoBackend::IoUring) {
+        return std::make_unique<UringReactor>(id, port, running);
+    }
+    return std::make_unique<EpollReactor>(id, port, running);
+}
+
+int Reactor::openListenSocket() {
+    int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (serverSocket < 0) {
+        LOG_ERROR("Failed to create socket.");
+        return -1;
+    }
+
+    // Set the server socket to non-blocking mode
+    if (fcntl(serverSocket, F_SETFL, O_NONBLOCK) < 0) {
+        LOG_ERROR("Failed to set server socket to non-blocking mode.");
+        close(serverSocket);
+        return -1;
+    }
+
+    int val = 1;
+    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val)) < 0) {
+        LOG_ERROR("Failed to set socket options.");
+        close(serverSocket);
+        return -1;
+    }
+
+    // Every reactor binds its own socket to the same port
+    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, &val, sizeof(val)) < 0) {
+        LOG_ERROR("Failed to set SO_REUSEPORT.");
+        close(serverSocket);
+        return -1;
+    }
+
+    sockaddr_in serverAddr{};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(port);
+    serverAddr.sin_addr.s_addr = INADDR_ANY;
+
+    if (bind(serverSocket, (struct sockaddr*) &serverAddr, sizeof(serverAddr)) < 0) {
+        LOG_ERROR("Failed to bind socket.");
+        close(serverSocket);
+        return -1;
+    }
+
+    if (listen(serverSocket, SOMAXCONN) < 0) {
+        LOG_ERROR("Failed to listen on socket.");
+        close(serverSocket);
+        return -1;
+    }
+
+    return serverSocket;
+}
+
+void Reactor::runCronIfDue() {
+    auto now = std::chrono::steady_clock::now();
+    if (now >= nextCron) {
+        cron();
+        nextCron = now + CRON_INTERVAL;
+    }
+}
+
+// Periodic housekeeping, run between batches of events
+void Reactor::cron() {
+    // The keyspace is shared, so one reactor is enough to drive active expiry
+    if (id == 0) {
+        Database::getInstance().activeExpireCycle(ACTIVE_EXPIRE_BUDGET);
+        Database::getInstance().incrementalRehash(REHASH_BUDGET);
+        Persistence::getInstance().cron();
+        Aof::getInstance().cron();
+    }
+}
+
+bool Reactor::processInput(Client& client) {
+    while (true) {
+        size_t parsedLen = 0;
+        std::string_view pending(client.readBuffer);
+        pending.remove_prefix(client.readPos);
+
+        RespParser::Result result = client.parser.parse(pending, parsedCommand, parsedLen);
+        if (result == RespParser::Result::Incomplete) {
+            return true; // Not enough data to parse a complete command
+        }
+        if (result == RespParser::Result::Error) {
+            LOG_WARNING("Protocol error from client " << client.socket << ".");
+            client.writeBuffer.append("-ERR Protocol error\r\n");
+            client.closeAfterWrite = true;
+            queueWrite(client);
+            return false;
+        }
+
+        // Handle the command. The tokens point into readBuffer, which is
+        // not touched again until the next recv.
+        uint64_t appends = Aof::appendCount();
+        std::string response = commandHandler.handleCommand(parsedCommand);
+        if (Aof::appendCount() != appends) {
+            client.awaitingSync = true;
+        }
+        LOG_DEBUG("Response: " << response);
+        client.writeBuffer.append(response);
+        queueWrite(client);
+
+        // Advance past the processed command instead of erasing it
+        client.readPos += parsedLen;
+    }
+}
+
+// Drops the consumed prefix of the read buffer. Called before each append, so
+// the memmove only happens once enough consumed bytes have piled up, and a
+// fully consumed buffer is simply cleared.
+void Reactor::compactReadBuffer(Client& client) {
+    if (client.readPos == 0) {
+        return;
+    }
+    if (client.readPos == client.readBuffer.size()) {
+        client.readBuffer.clear();
+        client.readPos = 0;
+    } else if (client.readPos >= READ_COMPACT_THRESHOLD && client.readPos * 2 >= client.readBuffer.size()) {
+        client.readBuffer.erase(0, client.readPos);
+        client.readPos = 0;
+    }
+}
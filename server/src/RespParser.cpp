@@ -0,0 +1,180 @@
+#include "../include/RespParser.h"
+#include <charconv>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Header lines (`*3`, `$5`, `+OK`) are short; anything longer without a CRLF is garbage
+static constexpr size_t MAX_LINE_LENGTH = 64 * 1024;
+
+size_t findCRLF(std::string_view buffer, size_t from) {
+    const char* data = buffer.data();
+    size_t size = buffer.size();
+    size_t i = from;
+
+#ifdef __SSE2__
+    // Compare 16 bytes at a time against '\r' and check candidates for a following '\n'
+    const __m128i cr = _mm_set1_epi8('\r');
+    while (i + 16 <= size) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, cr)));
+        while (mask != 0) {
+            size_t idx = i + __builtin_ctz(mask);
+            if (idx + 1 < size && data[idx + 1] == '\n') {
+                return idx;
+            }
+            mask &= mask - 1;
+        }
+        i += 16;
+    }
+#endif
+
+    // Tail (or the whole buffer without SSE2); glibc's memchr is vectorized too
+    while (i < size) {
+        const void* hit = std::memchr(data + i, '\r', size - i);
+        if (hit == nullptr) {
+            return std::string_view::npos;
+        }
+        size_t idx = static_cast<const char*>(hit) - data;
+        if (idx + 1 < size && data[idx + 1] == '\n') {
+            return idx;
+        }
+        i = idx + 1;
+    }
+    return std::string_view::npos;
+}
+
+static bool parseLength(std::string_view text, long long& value) {
+    if (text.empty()) {
+        return false;
+    }
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+void RespParser::reset() {
+    pos = 0;
+    scanPos = 0;
+    bulkLength = -1;
+    needed = 0;
+    started = false;
+    pendingElements.clear();
+    tokenOffsets.clear();
+}
+
+RespParser::Result RespParser::parse(std::string_view buffer, std::vector<std::string_view>& tokens, size_t& parsedLen) {
+    tokens.clear();
+    parsedLen = 0;
+
+    if (!started) {
+        if (buffer.empty()) {
+            return Result::Incomplete;
+        }
+        reset();
+        started = true;
+    }
+
+    bool finished = false;
+    while (!finished) {
+        if (bulkLength >= 0) {
+            // Waiting for the payload of a bulk string: no scanning, just a length check
+            size_t end = pos + static_cast<size_t>(bulkLength);
+            if (buffer.size() < end + 2) {
+                needed = end + 2 - buffer.size();
+                return Result::Incomplete;
+            }
+            if (buffer[end] != '\r' || buffer[end + 1] != '\n') {
+                return Result::Error;
+            }
+            tokenOffsets.emplace_back(pos, static_cast<size_t>(bulkLength));
+            pos = end + 2;
+            scanPos = pos;
+            bulkLength = -1;
+            needed = 0;
+            finished = elementDone();
+            continue;
+        }
+
+        size_t lineStart = pos;
+        std::string_view line;
+        if (!readLine(buffer, line)) {
+            if (buffer.size() - pos > MAX_LINE_LENGTH) {
+                return Result::Error;
+            }
+            return Result::Incomplete;
+        }
+        if (line.empty()) {
+            return Result::Error;
+        }
+
+        long long value;
+        switch (line[0]) {
+            case '*':
+                if (!parseLength(line.substr(1), value) || value < -1 || value > MAX_ARRAY_LENGTH) {
+                    return Result::Error;
+                }
+                if (value <= 0) {
+                    finished = elementDone(); // Empty or null array
+                } else {
+                    pendingElements.push_back(value);
+                }
+                break;
+            case '$':
+                if (!parseLength(line.substr(1), value) || value < -1 || value > MAX_BULK_LENGTH) {
+                    return Result::Error;
+                }
+                if (value < 0) {
+                    tokenOffsets.emplace_back(lineStart, 0); // Null bulk string
+                    finished = elementDone();
+                } else {
+                    bulkLength = value;
+                }
+                break;
+            case '+':
+            case '-':
+            case ':':
+                tokenOffsets.emplace_back(lineStart + 1, line.size() - 1);
+                finished = elementDone();
+                break;
+            default:
+                return Result::Error;
+        }
+    }
+
+    tokens.reserve(tokenOffsets.size());
+    for (const auto& token : tokenOffsets) {
+        tokens.push_back(buffer.substr(token.first, token.second));
+    }
+    parsedLen = pos;
+    started = false;
+    return Result::Complete;
+}
+
+// Reads the line starting at pos. The CRLF search resumes where the previous
+// attempt gave up, so header bytes are scanned only once.
+bool RespParser::readLine(std::string_view buffer, std::string_view& line) {
+    size_t crlf = findCRLF(buffer, scanPos);
+    if (crlf == std::string_view::npos) {
+        // The last byte may be a '\r' whose '\n' has not arrived yet
+        scanPos = buffer.size() > pos ? buffer.size() - 1 : pos;
+        return false;
+    }
+    line = buffer.substr(pos, crlf - pos);
+    pos = crlf + 2;
+    scanPos = pos;
+    return true;
+}
+
+// Marks one element as finished, closing every array it completes. Returns
+// true once the top-level value is complete.
+bool RespParser::elementDone() {
+    while (!pendingElements.empty()) {
+        if (--pendingElements.back() > 0) {
+            return false;
+        }
+        pendingElements.pop_back();
+    }
+    return true;
+}
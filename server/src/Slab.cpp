@@ -0,0 +1,141 @@
+#include "../include/Slab.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+static constexpr size_t CLASS_COUNT = Slab::MAX_SIZE / Slab::GRANULARITY;
+static constexpr size_t PAGE_SIZE = 64 * 1024;
+static constexpr uint32_t BATCH = 32; // Blocks moved between a thread's list and the shared one at a time
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct alignas(64) SizeClass {
+    std::mutex mutex;
+    FreeBlock* freeList = nullptr;
+};
+
+static SizeClass sizeClasses[CLASS_COUNT];
+static std::atomic<size_t> totalPageBytes{0};
+
+// Trivially destructible, so blocks freed while the thread is being torn
+// down (or, for the main thread, by static destructors) still find it
+struct ThreadCache {
+    FreeBlock* lists[CLASS_COUNT];
+    uint32_t counts[CLASS_COUNT];
+    bool registered; // CacheRelease constructed for this thread
+    bool retired; // The thread is exiting: blocks go straight to the shared lists
+};
+
+static thread_local ThreadCache cache;
+
+static size_t classIndex(size_t size) {
+    return size == 0 ? 0 : (size - 1) / Slab::GRANULARITY;
+}
+
+// Moves up to `count` blocks from the thread's list onto the shared one
+static void releaseBlocks(size_t index, uint32_t count) {
+    FreeBlock* first = cache.lists[index];
+    if (first == nullptr) {
+        return;
+    }
+    FreeBlock* last = first;
+    uint32_t moved = 1;
+    while (moved < count && last->next != nullptr) {
+        last = last->next;
+        moved++;
+    }
+    cache.lists[index] = last->next;
+    cache.counts[index] -= moved;
+
+    SizeClass& sizeClass = sizeClasses[index];
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    last->next = sizeClass.freeList;
+    sizeClass.freeList = first;
+}
+
+struct CacheRelease {
+    ~CacheRelease() {
+        for (size_t index = 0; index < CLASS_COUNT; index++) {
+            releaseBlocks(index, UINT32_MAX);
+        }
+        cache.retired = true;
+    }
+};
+
+static void registerThreadCache() {
+    thread_local CacheRelease release; // Hands the cached blocks back when the thread exits
+    cache.registered = true;
+}
+
+// Cuts a new page into blocks of the class. Caller holds the class lock.
+static void carvePage(SizeClass& sizeClass, size_t index) {
+    size_t blockSize = (index + 1) * Slab::GRANULARITY;
+    char* page = static_cast<char*>(::operator new(PAGE_SIZE));
+    for (size_t offset = PAGE_SIZE / blockSize * blockSize; offset >= blockSize; offset -= blockSize) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(page + offset - blockSize);
+        block->next = sizeClass.freeList;
+        sizeClass.freeList = block;
+    }
+    totalPageBytes.fetch_add(PAGE_SIZE, std::memory_order_relaxed);
+}
+
+// Takes a batch from the shared list (one block once the thread is retiring)
+static void refill(size_t index) {
+    if (!cache.registered) {
+        registerThreadCache();
+    }
+    SizeClass& sizeClass = sizeClasses[index];
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    uint32_t want = cache.retired ? 1 : BATCH;
+    for (uint32_t i = 0; i < want; i++) {
+        if (sizeClass.freeList == nullptr) {
+            carvePage(sizeClass, index);
+        }
+        FreeBlock* block = sizeClass.freeList;
+        sizeClass.freeList = block->next;
+        block->next = cache.lists[index];
+        cache.lists[index] = block;
+        cache.counts[index]++;
+    }
+}
+
+void* Slab::allocate(size_t size) {
+    if (size > MAX_SIZE) {
+        return ::operator new(size);
+    }
+    size_t index = classIndex(size);
+    if (cache.lists[index] == nullptr) {
+        refill(index);
+    }
+    FreeBlock* block = cache.lists[index];
+    cache.lists[index] = block->next;
+    cache.counts[index]--;
+    return block;
+}
+
+void Slab::deallocate(void* block, size_t size) {
+    if (size > MAX_SIZE) {
+        ::operator delete(block);
+        return;
+    }
+    if (!cache.registered) {
+        registerThreadCache();
+    }
+    size_t index = classIndex(size);
+    FreeBlock* freed = static_cast<FreeBlock*>(block);
+    freed->next = cache.lists[index];
+    cache.lists[index] = freed;
+    cache.counts[index]++;
+
+    if (cache.retired) {
+        releaseBlocks(index, UINT32_MAX);
+    } else if (cache.counts[index] > 2 * BATCH) {
+        releaseBlocks(index, BATCH);
+    }
+}
+
+size_t Slab::pageBytes() {
+    return totalPageBytes.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,60 @@
+#include "../include/SlowLog.h"
+
+SlowLog& SlowLog::getInstance() {
+    static SlowLog instance;
+    return instance;
+}
+
+void SlowLog::configure(long long threshold, size_t maxLength) {
+    logSlowerThan.store(threshold, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex);
+    this->maxLength = maxLength;
+    while (entries.size() > maxLength) {
+        entries.pop_back();
+    }
+}
+
+// Arguments are copied truncated, so one huge SET cannot pin its value here
+void SlowLog::add(const std::vector<std::string_view>& args, uint64_t micros) {
+    Entry entry{0, std::time(nullptr), micros, {}};
+    size_t kept = args.size() > MAX_ARGS ? MAX_ARGS - 1 : args.size();
+    entry.args.reserve(kept + 1);
+    for (size_t i = 0; i < kept; i++) {
+        std::string_view arg = args[i];
+        if (arg.size() > MAX_ARG_LENGTH) {
+            entry.args.emplace_back(arg.substr(0, MAX_ARG_LENGTH));
+            entry.args.back() += "... (" + std::to_string(arg.size() - MAX_ARG_LENGTH) + " more bytes)";
+        } else {
+            entry.args.emplace_back(arg);
+        }
+    }
+    if (kept < args.size()) {
+        entry.args.push_back("... (" + std::to_string(args.size() - kept) + " more arguments)");
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (maxLength == 0) {
+        return;
+    }
+    entry.id = nextId++;
+    entries.push_front(std::move(entry));
+    if (entries.size() > maxLength) {
+        entries.pop_back();
+    }
+}
+
+std::vector<SlowLog::Entry> SlowLog::get(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t n = count < entries.size() ? count : entries.size();
+    return std::vector<Entry>(entries.begin(), entries.begin() + n);
+}
+
+size_t SlowLog::length() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+void SlowLog::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+}
@@ -0,0 +1,305 @@
+#include "../include/Snapshot.h"
+#include "../include/Encoding.h"
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// CRC-32 (IEEE), slicing-by-8 so checksumming a large snapshot is not the bottleneck
+static constexpr std::array<std::array<uint32_t, 256>, 8> buildCrcTables() {
+    std::array<std::array<uint32_t, 256>, 8> tables{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0);
+        }
+        tables[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (size_t t = 1; t < 8; t++) {
+            tables[t][i] = (tables[t - 1][i] >> 8) ^ tables[0][tables[t - 1][i] & 0xFF];
+        }
+    }
+    return tables;
+}
+
+static constexpr auto CRC_TABLES = buildCrcTables();
+
+uint32_t crc32(uint32_t crc, const char* data, size_t len) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    crc = ~crc;
+    while (len >= 8) {
+        uint32_t low = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24));
+        crc = CRC_TABLES[7][low & 0xFF] ^ CRC_TABLES[6][(low >> 8) & 0xFF] ^
+              CRC_TABLES[5][(low >> 16) & 0xFF] ^ CRC_TABLES[4][low >> 24] ^
+              CRC_TABLES[3][p[4]] ^ CRC_TABLES[2][p[5]] ^
+              CRC_TABLES[1][p[6]] ^ CRC_TABLES[0][p[7]];
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) {
+        crc = (crc >> 8) ^ CRC_TABLES[0][(crc ^ *p++) & 0xFF];
+    }
+    return ~crc;
+}
+
+std::string SnapshotWriter::tempFilenameFor(const std::string& filename, pid_t pid) {
+    return filename + ".tmp." + std::to_string(pid);
+}
+
+static constexpr size_t SECTION_ENTRY_SIZE = 8 + 8 + 8 + 4;
+
+static size_t sectionHeaderSize(uint32_t sectionCount) {
+    return sizeof(SNAPSHOT_MAGIC) + 1 + 4 + sectionCount * SECTION_ENTRY_SIZE + 4;
+}
+
+static void appendFixed(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+static uint64_t decodeFixed(const char* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+    }
+    return value;
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& filename, uint32_t sectionCount)
+    : filename(filename), tempFilename(tempFilenameFor(filename, getpid())),
+      headerSize(sectionHeaderSize(sectionCount)) {
+    fd = ::open(tempFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    buffer.reserve(BUFFER_SIZE + 64);
+    buffer.assign(headerSize, '\0'); // Placeholder until finish() knows the offsets
+    sections.reserve(sectionCount);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (fd >= 0) {
+        // finish() was not reached or failed: drop the partial file
+        close(fd);
+        unlink(tempFilename.c_str());
+    }
+}
+
+void SnapshotWriter::writeFixed64(uint64_t value) {
+    appendFixed(buffer, value, 8);
+    maybeFlush();
+}
+
+void SnapshotWriter::writeVarint(uint64_t value) {
+    appendVarint(buffer, value);
+    maybeFlush();
+}
+
+void SnapshotWriter::writeString(std::string_view value) {
+    appendVarint(buffer, value.size());
+    if (value.size() >= BUFFER_SIZE) {
+        // Large values go straight to the file instead of through the buffer
+        flush();
+        crc = crc32(crc, value.data(), value.size());
+        writeAll(value.data(), value.size());
+        return;
+    }
+    buffer.append(value);
+    maybeFlush();
+}
+
+void SnapshotWriter::writeAll(const char* data, size_t len) {
+    while (len > 0 && !failed) {
+        ssize_t written = ::write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failed = true;
+            return;
+        }
+        data += written;
+        len -= written;
+        offset += written;
+    }
+}
+
+void SnapshotWriter::flush() {
+    crc = crc32(crc, buffer.data(), buffer.size());
+    writeAll(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+void SnapshotWriter::beginSection() {
+    flush();
+    crc = 0;
+    sections.push_back({offset, 0, 0, 0});
+}
+
+void SnapshotWriter::endSection(uint64_t keys) {
+    flush();
+    SnapshotSection& section = sections.back();
+    section.length = offset - section.offset;
+    section.keys = keys;
+    section.crc = crc;
+}
+
+bool SnapshotWriter::finish() {
+    if (fd < 0) {
+        return false;
+    }
+    flush();
+
+    std::string header;
+    header.reserve(headerSize);
+    header.append(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.push_back(static_cast<char>(SNAPSHOT_VERSION));
+    appendFixed(header, sections.size(), 4);
+    for (const SnapshotSection& section : sections) {
+        appendFixed(header, section.offset, 8);
+        appendFixed(header, section.length, 8);
+        appendFixed(header, section.keys, 8);
+        appendFixed(header, section.crc, 4);
+    }
+    appendFixed(header, crc32(0, header.data(), header.size()), 4);
+    if (header.size() != headerSize || pwrite(fd, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size())) {
+        failed = true; // Fewer sections than announced, or the write failed
+    }
+
+    if (failed || fsync(fd) < 0) {
+        return false; // The destructor removes the temp file
+    }
+    close(fd);
+    fd = -1;
+    if (rename(tempFilename.c_str(), filename.c_str()) < 0) {
+        unlink(tempFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+SnapshotReader::~SnapshotReader() {
+    if (base != nullptr) {
+        munmap(const_cast<char*>(base), mappedSize);
+    }
+}
+
+bool SnapshotReader::open(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapped, st.st_size, MADV_WILLNEED); // Sections are read from several threads at once
+
+    base = static_cast<const char*>(mapped);
+    mappedSize = st.st_size;
+    pos = base;
+    end = base + mappedSize;
+    return true;
+}
+
+bool SnapshotReader::hasMagic() const {
+    return mappedSize >= sizeof(SNAPSHOT_MAGIC) && std::memcmp(base, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0;
+}
+
+bool SnapshotReader::readHeader(uint8_t& version) {
+    if (!hasMagic()) {
+        return false;
+    }
+    pos = base + sizeof(SNAPSHOT_MAGIC);
+    return readByte(version);
+}
+
+bool SnapshotReader::verifyChecksum() {
+    if (mappedSize < sizeof(SNAPSHOT_MAGIC) + 1 + 1 + 4) {
+        return false;
+    }
+    const char* trailer = base + mappedSize - 4;
+    if (crc32(0, base, mappedSize - 4) != decodeFixed(trailer, 4)) {
+        return false;
+    }
+    end = trailer;
+    return true;
+}
+
+bool SnapshotReader::readSections(std::vector<SnapshotSection>& sections) {
+    const char* countStart = base + sizeof(SNAPSHOT_MAGIC) + 1;
+    if (mappedSize < sectionHeaderSize(0)) {
+        return false;
+    }
+    uint32_t count = decodeFixed(countStart, 4);
+    size_t headerSize = sectionHeaderSize(count);
+    if (count > (mappedSize - sectionHeaderSize(0)) / SECTION_ENTRY_SIZE ||
+        crc32(0, base, headerSize - 4) != decodeFixed(base + headerSize - 4, 4)) {
+        return false;
+    }
+
+    sections.resize(count);
+    const char* p = countStart + 4;
+    for (SnapshotSection& section : sections) {
+        section.offset = decodeFixed(p, 8);
+        section.length = decodeFixed(p + 8, 8);
+        section.keys = decodeFixed(p + 16, 8);
+        section.crc = decodeFixed(p + 24, 4);
+        p += SECTION_ENTRY_SIZE;
+        if (section.offset < headerSize || section.offset > mappedSize ||
+            section.length > mappedSize - section.offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SnapshotReader::verifySection(const SnapshotSection& section) const {
+    return crc32(0, base + section.offset, section.length) == section.crc;
+}
+
+SnapshotReader SnapshotReader::section(const SnapshotSection& section) const {
+    return SnapshotReader(base + section.offset, base + section.offset + section.length);
+}
+
+bool SnapshotReader::readByte(uint8_t& value) {
+    if (pos >= end) {
+        return false;
+    }
+    value = static_cast<uint8_t>(*pos++);
+    return true;
+}
+
+bool SnapshotReader::readFixed64(uint64_t& value) {
+    if (end - pos < 8) {
+        return false;
+    }
+    value = decodeFixed(pos, 8);
+    pos += 8;
+    return true;
+}
+
+bool SnapshotReader::readVarint(uint64_t& value) {
+    size_t used = decodeVarint(pos, end, value);
+    pos += used;
+    return used != 0;
+}
+
+bool SnapshotReader::readString(std::string_view& value) {
+    uint64_t len;
+    if (!readVarint(len) || len > static_cast<uint64_t>(end - pos)) {
+        return false;
+    }
+    value = std::string_view(pos, len);
+    pos += len;
+    return true;
+}
@@ -0,0 +1,125 @@
+#include "../include/Stats.h"
+#include <bit>
+
+size_t LatencyHistogram::bucketFor(uint64_t micros) {
+    if (micros < SUB_BUCKETS) {
+        return micros;
+    }
+    unsigned magnitude = std::bit_width(micros) - 1;
+    if (magnitude >= MAX_MAGNITUDE) {
+        return BUCKETS - 1;
+    }
+    unsigned shift = magnitude - SUB_BUCKET_BITS;
+    uint64_t sub = (micros >> shift) - SUB_BUCKETS; // The SUB_BUCKET_BITS below the top bit
+    return (shift + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketLimit(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned shift = bucket / SUB_BUCKETS - 1;
+    uint64_t sub = bucket % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        counts[bucket] += other.counts[bucket];
+    }
+    total += other.total;
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(fraction * total);
+    if (rank >= total) {
+        rank = total - 1;
+    }
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += counts[bucket];
+        if (seen > rank) {
+            return bucketLimit(bucket);
+        }
+    }
+    return bucketLimit(BUCKETS - 1);
+}
+
+Stats& Stats::getInstance() {
+    static Stats instance;
+    return instance;
+}
+
+// Registers the calling thread's counters on first use
+Stats::ThreadCounters& Stats::localCounters() {
+    thread_local ThreadCounters* counters = nullptr;
+    if (counters == nullptr) {
+        auto owned = std::make_unique<ThreadCounters>();
+        counters = owned.get();
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.push_back(std::move(owned));
+    }
+    return *counters;
+}
+
+// Only the owning thread writes a counter, so a relaxed load and store is
+// enough and readers see a value that is at worst one call behind
+static void bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void Stats::recordCommand(size_t command, uint64_t micros) {
+    CommandCounters& counters = localCounters().commands[command];
+    bump(counters.calls, 1);
+    bump(counters.micros, micros);
+    bump(counters.latency[LatencyHistogram::bucketFor(micros)], 1);
+}
+
+std::vector<Stats::CommandSummary> Stats::commandSummaries() {
+    std::vector<CommandSummary> summaries(MAX_COMMANDS);
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& thread : threads) {
+        for (size_t i = 0; i < MAX_COMMANDS; i++) {
+            const CommandCounters& counters = thread->commands[i];
+            uint64_t calls = counters.calls.load(std::memory_order_relaxed);
+            if (calls == 0) {
+                continue;
+            }
+            CommandSummary& summary = summaries[i];
+            summary.calls += calls;
+            summary.micros += counters.micros.load(std::memory_order_relaxed);
+            for (size_t bucket = 0; bucket < LatencyHistogram::BUCKETS; bucket++) {
+                if (uint64_t count = counters.latency[bucket].load(std::memory_order_relaxed)) {
+                    summary.latency.add(bucket, count);
+                }
+            }
+        }
+    }
+    return summaries;
+}
+
+void Stats::clientConnected() {
+    connected.fetch_add(1, std::memory_order_relaxed);
+    connections.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stats::clientDisconnected() {
+    connected.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void Stats::connectionRejected() {
+    rejected.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stats::setServerInfo(int port, unsigned int eventLoops, const std::string& ioBackend) {
+    this->port = port;
+    this->eventLoops = eventLoops;
+    this->ioBackend = ioBackend;
+}
+
+uint64_t Stats::uptimeSeconds() const {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - startTime).count();
+}
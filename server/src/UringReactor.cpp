@@ -0,0 +1,362 @@
+#include "../include/UringReactor.h"
+#include "../include/Aof.h"
+#include "../include/Logger.h"
+#include "../include/Stats.h"
+#include "../include/LatencyMonitor.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+UringReactor::UringReactor(int id, int port, std::atomic<bool>& running)
+    : Reactor(id, port, running) {}
+
+UringReactor::~UringReactor() {
+    for (auto& client : clients) {
+        close(client.second.socket);
+    }
+    if (serverSocket >= 0) {
+        close(serverSocket);
+    }
+}
+
+// Result of the first completion for `operation`, or -ETIME if none arrives
+static int waitForCompletion(IoUring& ring, uint64_t operation, int shift) {
+    int result = -ETIME;
+    for (int attempt = 0; attempt < 10 && result == -ETIME; attempt++) {
+        if (ring.submitAndWait(std::chrono::milliseconds(100)) < 0 && errno != EBUSY) {
+            return -errno;
+        }
+        ring.forEachCompletion([&](const io_uring_cqe& cqe) {
+            if (result == -ETIME && cqe.user_data >> shift == operation) {
+                result = cqe.res;
+            }
+        });
+    }
+    return result;
+}
+
+bool UringReactor::probe() {
+    IoUring ring;
+    if (!ring.init(8)) {
+        LOG_WARNING("io_uring is not available on this kernel.");
+        return false;
+    }
+    if (!ring.setupBufferRing(BUFFER_GROUP, 2, 64)) {
+        LOG_WARNING("io_uring provided buffer rings are not available on this kernel.");
+        return false;
+    }
+
+    // A loopback connection to accept and receive on
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int client = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int accepted = -1;
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    bool ok = listener >= 0 && client >= 0 &&
+              bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+              listen(listener, 1) == 0 &&
+              getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) == 0;
+    if (!ok) {
+        LOG_WARNING("Could not open a loopback connection to probe io_uring: " << std::strerror(errno));
+    }
+
+    if (ok) {
+        io_uring_sqe* sqe = ring.getSqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = listener;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->user_data = static_cast<uint64_t>(Accept) << OPERATION_SHIFT;
+        ok = connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        accepted = ok ? waitForCompletion(ring, Accept, OPERATION_SHIFT) : -1;
+        if (ok && accepted < 0) {
+            LOG_WARNING("io_uring multishot accept is not supported by this kernel: " << std::strerror(-accepted));
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        io_uring_sqe* sqe = ring.getSqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = accepted;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->user_data = static_cast<uint64_t>(Recv) << OPERATION_SHIFT;
+        ok = send(client, "x", 1, MSG_NOSIGNAL) == 1;
+        int received = ok ? waitForCompletion(ring, Recv, OPERATION_SHIFT) : -1;
+        if (ok && received <= 0) {
+            LOG_WARNING("io_uring multishot receive is not supported by this kernel: "
+                        << std::strerror(received < 0 ? -received : EIO));
+            ok = false;
+        }
+    }
+
+    for (int fd : {accepted, client, listener}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    return ok;
+}
+
+bool UringReactor::setup() {
+    // probe() has checked that the kernel supports all of this
+    if (!ring.init(RING_ENTRIES)) {
+        LOG_ERROR("Failed to set up io_uring.");
+        return false;
+    }
+    if (!ring.setupBufferRing(BUFFER_GROUP, RECV_BUFFER_COUNT, RECV_BUFFER_SIZE)) {
+        LOG_ERROR("Failed to register the io_uring receive buffers.");
+        return false;
+    }
+
+    serverSocket = openListenSocket();
+    return serverSocket >= 0;
+}
+
+void UringReactor::run() {
+    nextCron = std::chrono::steady_clock::now() + CRON_INTERVAL;
+    armAccept();
+
+    while (running) {
+        // Submits the previous iteration's sends and re-arms in the same call
+        if (ring.submitAndWait(std::chrono::milliseconds(EPOLL_TIMEOUT_MS)) < 0 && errno != EBUSY) {
+            LOG_ERROR("io_uring_enter failed: " << std::strerror(errno));
+            break;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        ring.forEachCompletion([this](const io_uring_cqe& cqe) {
+            handleCompletion(cqe);
+        });
+
+        // Commit this iteration's writes before any of their replies can go out
+        flushPendingWrites(Aof::getInstance().flush());
+
+        runCronIfDue();
+        LatencyMonitor::getInstance().record("event-loop", start);
+    }
+}
+
+void UringReactor::handleCompletion(const io_uring_cqe& cqe) {
+    uint64_t operation = cqe.user_data >> OPERATION_SHIFT;
+    uint64_t clientId = cqe.user_data & ((uint64_t(1) << OPERATION_SHIFT) - 1);
+
+    if (operation == Accept) {
+        onAccept(cqe);
+        return;
+    }
+
+    auto it = clients.find(clientId);
+    if (it == clients.end()) {
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            ring.recycleBuffer(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        }
+        return;
+    }
+    if (operation == Recv) {
+        onRecv(it->second, cqe);
+    } else if (operation == Send) {
+        onSend(it->second, cqe);
+    }
+    releaseIfDone(clientId);
+}
+
+void UringReactor::armAccept() {
+    io_uring_sqe* sqe = ring.getSqe();
+    if (sqe == nullptr) {
+        LOG_ERROR("io_uring submission queue is full.");
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = serverSocket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = static_cast<uint64_t>(Accept) << OPERATION_SHIFT;
+    accepting = true;
+}
+
+void UringReactor::onAccept(const io_uring_cqe& cqe) {
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        accepting = false;
+    }
+
+    if (cqe.res < 0) {
+        if (cqe.res == -EINVAL) {
+            // Re-arming would fail the same way, and a server that cannot accept must not keep running
+            LOG_ERROR("Multishot accept is not supported by this kernel, shutting down.");
+            running = false;
+            return;
+        }
+        LOG_ERROR("Failed to accept client connection.");
+    } else if (clients.size() >= MAX_CLIENTS) {
+        LOG_WARNING("Maximum number of clients reached. Closing new connection.");
+        close(cqe.res);
+        Stats::getInstance().connectionRejected();
+    } else {
+        LOG_DEBUG("Reactor " << id << " accepted new client connection: " << cqe.res);
+        uint64_t clientId = nextClientId++;
+        UringClient& client = clients[clientId];
+        client.id = clientId;
+        client.socket = cqe.res;
+        Stats::getInstance().clientConnected();
+        armRecv(client);
+    }
+
+    if (!accepting && running) {
+        armAccept();
+    }
+}
+
+void UringReactor::armRecv(UringClient& client) {
+    io_uring_sqe* sqe = ring.getSqe();
+    if (sqe == nullptr) {
+        LOG_ERROR("io_uring submission queue is full.");
+        startClose(client);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = client.socket;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = (static_cast<uint64_t>(Recv) << OPERATION_SHIFT) | client.id;
+    client.receiving = true;
+}
+
+void UringReactor::onRecv(UringClient& client, const io_uring_cqe& cqe) {
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+    if (!more) {
+        client.receiving = false;
+    }
+
+    if (cqe.res > 0) {
+        uint16_t bufferId = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        // After a protocol error the rest of the input is ignored
+        if (!client.closing && !client.closeAfterWrite) {
+            compactReadBuffer(client);
+            client.readBuffer.append(ring.buffer(bufferId), cqe.res);
+            processInput(client);
+        }
+        ring.recycleBuffer(bufferId);
+    } else if (cqe.res != -ENOBUFS) {
+        // 0 is an orderly disconnect; -ENOBUFS only means every buffer was in
+        // use, and they have been handed back by now
+        if (cqe.res < 0 && cqe.res != -ECONNRESET && !client.closing) {
+            LOG_WARNING("Error reading from client socket.");
+        }
+        startClose(client);
+        return;
+    }
+
+    if (!more && !client.closing) {
+        armRecv(client);
+    }
+}
+
+void UringReactor::queueWrite(Client& client) {
+    if (!client.queued) {
+        client.queued = true;
+        pendingWrites.push_back(static_cast<UringClient&>(client).id);
+    }
+}
+
+// Prepares one send per client with replies from this iteration. They are
+// submitted together by the next io_uring_enter, after the log has been flushed.
+// If the log could not be synced, the clients whose commands were logged are
+// disconnected unanswered instead; the others get their replies.
+void UringReactor::flushPendingWrites(bool logSynced) {
+    for (uint64_t clientId : pendingWrites) {
+        auto it = clients.find(clientId);
+        if (it == clients.end()) {
+            continue; // Closed after its reply was queued
+        }
+        UringClient& client = it->second;
+        client.queued = false;
+        bool unsynced = client.awaitingSync && !logSynced;
+        client.awaitingSync = false;
+        if (unsynced) {
+            startClose(client);
+            releaseIfDone(clientId);
+        } else if (!client.sending && !client.closing) {
+            submitSend(client); // Otherwise onSend picks the new replies up
+            releaseIfDone(clientId); // In case the send could not be queued
+        }
+    }
+    pendingWrites.clear();
+}
+
+// The kernel reads from sendBuffer until the send completes, so new replies
+// collect in writeBuffer meanwhile and the two are swapped between sends
+void UringReactor::submitSend(UringClient& client) {
+    if (client.sendPos == client.sendBuffer.size()) {
+        client.sendBuffer.clear();
+        client.sendPos = 0;
+        std::swap(client.sendBuffer, client.writeBuffer);
+    }
+    if (client.sendBuffer.empty()) {
+        return;
+    }
+
+    io_uring_sqe* sqe = ring.getSqe();
+    if (sqe == nullptr) {
+        LOG_ERROR("io_uring submission queue is full.");
+        startClose(client);
+        return;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = client.socket;
+    sqe->addr = reinterpret_cast<uint64_t>(client.sendBuffer.data() + client.sendPos);
+    sqe->len = static_cast<uint32_t>(std::min<size_t>(client.sendBuffer.size() - client.sendPos, UINT32_MAX));
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (static_cast<uint64_t>(Send) << OPERATION_SHIFT) | client.id;
+    client.sending = true;
+}
+
+void UringReactor::onSend(UringClient& client, const io_uring_cqe& cqe) {
+    client.sending = false;
+    if (cqe.res < 0) {
+        if (!client.closing) {
+            LOG_WARNING("Error writing to client socket.");
+        }
+        startClose(client);
+        return;
+    }
+    client.sendPos += cqe.res;
+
+    if (client.sendPos < client.sendBuffer.size() || !client.writeBuffer.empty()) {
+        queueWrite(client); // The rest, or replies that arrived meanwhile, go out with this iteration's batch
+    } else if (client.closeAfterWrite) {
+        startClose(client);
+    }
+}
+
+// Shuts the socket down so the pending recv and send complete; the client
+// is released once they have
+void UringReactor::startClose(UringClient& client) {
+    if (client.closing) {
+        return;
+    }
+    client.closing = true;
+    shutdown(client.socket, SHUT_RDWR);
+}
+
+void UringReactor::releaseIfDone(uint64_t clientId) {
+    auto it = clients.find(clientId);
+    if (it == clients.end()) {
+        return;
+    }
+    UringClient& client = it->second;
+    if (client.closing && !client.receiving && !client.sending) {
+        close(client.socket);
+        LOG_DEBUG("Client connection closed: " << client.socket);
+        clients.erase(it);
+        Stats::getInstance().clientDisconnected();
+    }
+}
@@ -1,36 +1,64 @@
 #include "../include/Server.h"
 #include "../include/Database.h"
+#include "../include/Config.h"
+#include "../include/Hash.h"
+#include "../include/Persistence.h"
+#include "../include/Aof.h"
+#include "../include/Logger.h"
+#include "../include/SlowLog.h"
+#include "../include/LatencyMonitor.h"
 #include <iostream>
-#include <thread>
-#include <chrono>
+#include <unistd.h>
 
 int main(int argc, char* argv[]) {
 
-    int PORT = argc > 1 ? std::stoi(argv[1]) : 6379;
+    Config config;
+    if (!parseConfig(argc, argv, config)) {
+        std::cerr << "Usage: " << argv[0] << " [port] [--threads n] [--io-backend epoll|io_uring] [--maxmemory bytes] [--maxmemory-policy noeviction|allkeys-lru|allkeys-lfu|volatile-ttl] [--save \"seconds changes ...\"] [--appendonly yes|no] [--appendfsync always|everysec|no] [--slowlog-log-slower-than us] [--slowlog-max-len n] [--latency-monitor-threshold ms] [--loglevel debug|info|warning|error]" << std::endl;
+        return 1;
+    }
+
+    Logger::getInstance().setLevel(config.logLevel);
+    Logger::getInstance().start();
+
+    Hash::setLimits(config.hashMaxPackedEntries, config.hashMaxPackedValue);
 
-    Server server(PORT);
+    Server server(config.port, config.threads, config.ioBackend);
 
-    if (!Database::getInstance().loadDatabase("dump")) {
-        std::cerr << "Failed to load database." << std::endl;
+    bool replayLog = config.appendOnly && access(config.appendFilename.c_str(), F_OK) == 0;
+    if (replayLog) {
+        // The log is at least as recent as the snapshot
+        if (!Aof::getInstance().load(config.appendFilename)) {
+            LOG_ERROR("Failed to load append only file " << config.appendFilename << ", refusing to start.");
+            return 1;
+        }
+    } else if (!Database::getInstance().loadDatabase("dump")) {
+        LOG_WARNING("Failed to load database.");
     } else {
-        std::cout << "Database loaded successfully from dump" << std::endl;
+        LOG_INFO("Database loaded successfully from dump");
     }
 
-    // Background processes to dump db
-    std::thread Persistence([] () {
-        while (true) {
-            std::this_thread::sleep_for(std::chrono::seconds(30));
-            // Dump the db
-            if (Database::getInstance().dumpDatabase("dump")) {
-                std::cout << "Database dumped successfully." << std::endl;
-            } else {
-                std::cerr << "Failed to dump database." << std::endl;
-            }
+    if (config.appendOnly) {
+        if (!Aof::getInstance().open(config.appendFilename, config.appendFsync)) {
+            return 1;
+        }
+        if (!replayLog) {
+            // New log: seed it with whatever came from the snapshot
+            Aof::getInstance().backgroundRewrite();
         }
-    });
-    Persistence.detach();
+    }
+
+    // Applied after loading, so a dataset from disk is never evicted while it is read back
+    Database::getInstance().setMaxMemory(config.maxMemory, config.maxMemoryPolicy);
+
+    SlowLog::getInstance().configure(config.slowlogLogSlowerThan, config.slowlogMaxLen);
+    LatencyMonitor::getInstance().setThreshold(std::chrono::milliseconds(config.latencyMonitorThreshold));
+
+    // Snapshots are taken by the event loop when a save rule matches
+    Persistence::getInstance().configure("dump", config.saveRules);
 
-    server.run();
+    bool started = server.run();
 
-    return 0;
+    Logger::getInstance().stop();
+    return started ? 0 : 1;
 }
\ No newline at end of file